@@ -0,0 +1,74 @@
+#ifndef CLUSTER_HIERARCHY_H
+#define CLUSTER_HIERARCHY_H
+
+#include <glm/glm.hpp>
+
+#include <vector>
+
+#include "Vertex.h"
+
+// A small run of triangles within a clustered mesh; every cluster is either drawn in full or not at all. Errors are measured from
+// spheres shared by every cluster simplified out of the same group, so a cluster and the clusters replacing it always agree on
+// which of them to draw
+struct Cluster
+{
+	unsigned int firstIndex; // Relative to the start of the mesh's indices
+	unsigned int indexCount;
+	glm::vec4 bounds; // Around the cluster's own triangles, for culling; center in xyz and radius in w
+	glm::vec4 lodBounds;
+	float lodError; // How far this cluster strays from the full-detail surface, 0 for the clusters it starts with
+	glm::vec4 parentBounds;
+	float parentError; // Of the clusters that replace this one, or the largest float for clusters nothing replaces
+};
+
+struct ClusterOptions
+{
+	unsigned int maxTriangles = 124;
+	unsigned int maxVertices = 64;
+	unsigned int groupSize = 4; // Neighboring clusters simplified together, with the borders between groups locked
+	float minReduction = 0.15f; // Groups that lose less of their triangles are left as roots of the hierarchy
+	unsigned int maxLevels = 16;
+};
+
+// Every level of the hierarchy shares the original vertices, since simplification only collapses vertices onto each other
+struct ClusterHierarchy
+{
+	std::vector<unsigned int> indices;
+	std::vector<Cluster> clusters; // Level by level, starting with the full-detail clusters
+	unsigned int levelCount = 0;
+};
+
+// What the camera sees for one frame, for choosing which clusters to draw; by default, every full-detail cluster without culling
+struct ClusterView
+{
+	glm::vec4 frustum[6] = { glm::vec4(0.0f, 0.0f, 0.0f, 1.0f), glm::vec4(0.0f, 0.0f, 0.0f, 1.0f), glm::vec4(0.0f, 0.0f, 0.0f, 1.0f),
+		glm::vec4(0.0f, 0.0f, 0.0f, 1.0f), glm::vec4(0.0f, 0.0f, 0.0f, 1.0f), glm::vec4(0.0f, 0.0f, 0.0f, 1.0f) }; // Planes facing inward
+	glm::vec3 cameraPosition = glm::vec3(0.0f);
+	float projectionScale = 1.0f; // Pixels covered by one unit at a distance of one unit
+	float nearDistance = 1.0f; // Errors are projected from no closer than this, so they stay finite with the camera inside a cluster's sphere
+	float errorThreshold = 0.0f; // In pixels
+};
+
+// A range of indices drawn with one command; neighboring clusters in the cut are merged into one run
+struct ClusterRun
+{
+	unsigned int firstIndex;
+	unsigned int indexCount;
+};
+
+// Splits the mesh into clusters of neighboring triangles, then repeatedly groups neighboring clusters, simplifies each group to
+// half of its triangles and splits it into clusters again, until one cluster remains or groups can't be simplified any further
+ClusterHierarchy buildClusterHierarchy(const std::vector<Vertex>& vertices, const std::vector<unsigned int>& indices, const ClusterOptions& options = ClusterOptions{});
+
+ClusterView makeClusterView(const glm::mat4& viewProjection, const glm::vec3& cameraPosition, const float fov, const float nearPlane, const float screenHeight,
+	const float pixelError);
+
+// Writes the cut through the hierarchy for one instance, keeping each cluster whose own error is below the view's threshold but
+// whose parent's is not, and culling clusters outside the frustum; runs must hold one per cluster. Returns the number of runs
+unsigned int selectClusters(const std::vector<Cluster>& clusters, const glm::mat4& model, const ClusterView& view, ClusterRun* runs);
+
+// True if the cut selectClusters takes covers the whole surface, culling aside: every full-detail cluster is either in the cut or
+// replaced by clusters that are all covered in turn. Only meant for checking a hierarchy, since it compares every pair of clusters
+bool isCutComplete(const std::vector<Cluster>& clusters, const glm::mat4& model, const ClusterView& view);
+
+#endif
@@ -0,0 +1,52 @@
+#ifndef FRAME_ARENA_H
+#define FRAME_ARENA_H
+
+#include <cstddef>
+#include <cstdint>
+
+// Linear allocator for transient per-frame data; everything allocated is released at once by reset
+class FrameArena
+{
+	public:
+		FrameArena(const size_t capacity);
+		~FrameArena();
+
+		FrameArena(const FrameArena&) = delete;
+		FrameArena& operator=(const FrameArena&) = delete;
+
+		// Returns nullptr if the arena is out of space; memory is uninitialized
+		template<typename T>
+		T* allocate(const size_t count)
+		{
+			const size_t alignment = alignof(T);
+			const uintptr_t address = reinterpret_cast<uintptr_t>(buffer) + used;
+			const size_t padding = (alignment - address % alignment) % alignment;
+			const size_t size = count * sizeof(T);
+
+			if (used + padding + size > capacity)
+			{
+				return nullptr;
+			}
+
+			T* result = reinterpret_cast<T*>(buffer + used + padding);
+			used += padding + size;
+			
+			if (used > highWater)
+			{
+				highWater = used;
+			}
+
+			return result;
+		}
+
+		void reset();
+		size_t getHighWater() const; // Most bytes used in any one frame, for sizing the arena
+
+	private:
+		unsigned char* buffer;
+		size_t capacity;
+		size_t used = 0;
+		size_t highWater = 0;
+};
+
+#endif
@@ -0,0 +1,51 @@
+#ifndef GL_STATE_H
+#define GL_STATE_H
+
+#include <glad/glad.h>
+
+#include <vector>
+#include <unordered_map>
+
+const unsigned int cachedTextureUnits = 16; // Units past these are always bound
+const unsigned int cachedTextureTargets = 2; // GL_TEXTURE_2D and GL_TEXTURE_2D_ARRAY
+
+// Calls made through the cache since counters were last reset
+struct GLStateCounters
+{
+	unsigned int issued = 0;
+	unsigned int skipped = 0; // Would have set state to what it already was
+};
+
+// Shadows the bound program, vertex array, textures per unit and integer uniforms such as samplers, so calls that wouldn't change
+// anything are never made; only works if every such call goes through it, starting from a fresh context
+class GLStateCache
+{
+	public:
+		GLStateCache();
+
+		void useProgram(const unsigned int program);
+		void bindVertexArray(const unsigned int vertexArray);
+		void bindTexture(const unsigned int unit, const GLenum target, const unsigned int texture); // Only changes the active unit if it has to bind
+		void setUniform(const int location, const int value); // For the program in use
+
+		// Deleting a bound object unbinds it, so the cache has to be told
+		void forgetVertexArray(const unsigned int vertexArray);
+		void forgetTexture(const unsigned int texture);
+		void forgetProgram(const unsigned int program);
+
+		void resetCounters();
+		const GLStateCounters& getCounters() const;
+
+	private:
+		unsigned int program = 0;
+		unsigned int vertexArray = 0;
+		unsigned int activeUnit = 0;
+		unsigned int textures[cachedTextureUnits][cachedTextureTargets];
+		std::unordered_map<unsigned int, std::vector<int>> uniforms; // Values set for each program, by location; unknown until set
+		std::vector<int>* programUniforms = nullptr;
+		GLStateCounters counters;
+};
+
+extern GLStateCache glState;
+
+#endif
@@ -0,0 +1,113 @@
+#ifndef GEOMETRY_POOL_H
+#define GEOMETRY_POOL_H
+
+#include <glm/glm.hpp>
+
+#include <vector>
+
+#include "Vertex.h"
+
+const unsigned int instanceMatrixLocation = 3; // A mat4 per instance takes this attribute location and the three after it
+const unsigned int instanceQuantizationLocation = 7; // Position offset, then scale at the next location
+const unsigned int instanceFadeLocation = 9;
+const float opaqueFade = 1.0f; // Fade of an instance drawn without any transition between levels of detail
+
+// Everything the vertex shader reads per instance; positions are decoded and texture array layers chosen per instance, so meshes
+// with different bounds or layers can share a draw
+struct InstanceData
+{
+	glm::mat4 model;
+	glm::vec4 positionOffset; // w is the diffuse layer
+	glm::vec4 positionScale; // w is the specular layer
+	float fade; // 1 when opaque; how far a level of detail has faded in while positive, or how far its replacement has while negative
+};
+
+const unsigned int cameraBlockBinding = 0;
+
+// Matches the std140 Camera block in shader.vs
+struct CameraBlock
+{
+	glm::mat4 view;
+	glm::mat4 projection;
+	glm::vec4 position; // w is unused
+};
+
+// Where one mesh's vertices and indices live within a GeometryPool, in elements rather than bytes
+struct GeometryRange
+{
+	VertexFormat format = VertexFormat::Full;
+	unsigned int baseVertex = 0;
+	unsigned int vertexCount = 0;
+	unsigned int firstIndex = 0; // Counted in indices of indexSize
+	unsigned int indexCount = 0;
+	unsigned int indexSize = sizeof(unsigned int); // Bytes per index, 2 for meshes with few enough vertices
+};
+
+// First-fit allocator over a range of elements, merging neighboring blocks as they are freed
+class RangeAllocator
+{
+	public:
+		RangeAllocator(const unsigned int capacity = 0);
+
+		bool allocate(const unsigned int size, unsigned int& offset, const unsigned int alignment = 1); // False when no free block is large enough
+		void free(const unsigned int offset, const unsigned int size);
+		void grow(const unsigned int capacity);
+		unsigned int getCapacity() const;
+
+	private:
+		struct Block
+		{
+			unsigned int offset;
+			unsigned int size;
+		};
+
+		std::vector<Block> freeBlocks; // Sorted by offset
+		unsigned int capacity;
+};
+
+// Suballocates every mesh and level of detail out of shared vertex and index buffers, so all meshes with the same vertex format
+// draw from one vertex array with glDrawElementsBaseVertex; buffers double in size when full, and the pool must be destroyed while the context exists
+class GeometryPool
+{
+	public:
+		// Each vertex format's buffer is only created once a mesh uses it, starting at vertexCapacity; indexCapacity counts 16-bit indices
+		GeometryPool(const unsigned int vertexCapacity, const unsigned int indexCapacity);
+		~GeometryPool();
+
+		GeometryPool(const GeometryPool&) = delete;
+		GeometryPool& operator=(const GeometryPool&) = delete;
+
+		// vertexData holds vertexCount vertices already encoded in format; indices are stored as 16 bits whenever vertexCount allows
+		GeometryRange allocate(const VertexFormat format, const std::vector<unsigned char>& vertexData, const unsigned int vertexCount, const std::vector<unsigned int>& indices);
+		void free(const GeometryRange& range);
+
+		unsigned int getVertexArray(const VertexFormat format) const;
+
+		// Every vertex array reads one InstanceData per instance from buffer, now and for any format created later
+		void setInstanceBuffer(const unsigned int buffer);
+		// Binds the vertex array for format with its first instance at instanceOffset bytes into the instance buffer, since
+		// OpenGL 3.3 has no base instance for draws
+		void bindVertexArray(const VertexFormat format, const size_t instanceOffset);
+
+	private:
+		struct VertexStore
+		{
+			RangeAllocator ranges;
+			unsigned int vertexArray = 0, vertexBuffer = 0; // IDs for each
+			size_t instanceOffset = 0;
+		};
+
+		void createVertexArray(const VertexFormat format);
+		void growVertices(const VertexFormat format, const unsigned int vertexCount);
+		void growIndices(const unsigned int slotCount);
+		void setVertexAttributes(const VertexFormat format) const;
+		void setInstanceAttributes(const size_t instanceOffset) const;
+
+		unsigned int initialVertexCapacity;
+		VertexStore vertexStores[vertexFormatCount];
+		RangeAllocator indexRanges; // Counted in 16-bit slots, with 32-bit indices taking two aligned slots each
+		unsigned int elementBuffer = 0;
+		unsigned int instanceBuffer = 0;
+};
+
+#endif
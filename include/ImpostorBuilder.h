@@ -0,0 +1,28 @@
+#ifndef IMPOSTOR_BUILDER_H
+#define IMPOSTOR_BUILDER_H
+
+#include <glm/glm.hpp>
+
+#include <vector>
+
+#include "Model.h"
+#include "GeometryPool.h"
+
+struct ImpostorOptions
+{
+	unsigned int frames = 8; // Views along each side of the atlas, so frames * frames views in all
+	unsigned int frameSize = 128; // Pixels along each side of one view
+};
+
+// Octahedral mapping between directions and atlas coordinates; shader.vs maps the direction of the camera from an impostor's center
+// the same way to pick the frame to show
+glm::vec2 encodeViewDirection(const glm::vec3& direction);
+glm::vec3 decodeViewDirection(const glm::vec2& coordinates);
+
+// Renders the first level of chains[chain] offscreen from every direction into an atlas, and returns a level of detail drawing it
+// as one quad per instance. Draws through its own InstanceBatcher and camera buffer, so the shader's samplers must already be set up,
+// and it must run before the scene's batcher is created, which takes over the pool's instance buffer
+Model buildImpostor(const std::vector<LODChain>& chains, const unsigned int chain, GeometryPool& pool, const unsigned int shader,
+	const ImpostorOptions& options = ImpostorOptions{});
+
+#endif
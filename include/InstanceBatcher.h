@@ -0,0 +1,92 @@
+#ifndef INSTANCE_BATCHER_H
+#define INSTANCE_BATCHER_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include <vector>
+
+#include "Model.h"
+#include "GeometryPool.h"
+#include "FrameArena.h"
+#include "RenderQueue.h"
+#include "StreamBuffer.h"
+#include "ClusterHierarchy.h"
+
+// Layout glMultiDrawElementsIndirect reads from the draw indirect buffer
+struct DrawElementsIndirectCommand
+{
+	unsigned int count;
+	unsigned int instanceCount;
+	unsigned int firstIndex;
+	int baseVertex;
+	unsigned int baseInstance;
+};
+
+// A run of commands sharing a shader, material, vertex array and index type, submitted with one multi-draw
+struct DrawGroup
+{
+	const Mesh* mesh; // Any mesh in the group, for its material and range
+	unsigned int firstCommand;
+	unsigned int commandCount;
+};
+
+// Groups models by LODChain and level of detail each frame, then writes one indirect command per mesh of every level in view along
+// with the instance data it reads, both into ring buffers. Clustered meshes instead get a command per run of clusters in each
+// instance's cut. Holds on to the chains' meshes, so it has to be given them again through setChains whenever they change, and it must be
+// destroyed while the context does
+class InstanceBatcher
+{
+	public:
+		// Falls back to one instanced draw per command when the context lacks glMultiDrawElementsIndirect or allowIndirect is false
+		InstanceBatcher(const std::vector<LODChain>& chains, GeometryPool& pool, const unsigned int shader, const bool allowIndirect = true);
+		~InstanceBatcher();
+
+		InstanceBatcher(const InstanceBatcher&) = delete;
+		InstanceBatcher& operator=(const InstanceBatcher&) = delete;
+
+		// Buckets the models with a counting sort, orders their commands by shader, material, vertex array and then distance from the
+		// camera, and uploads the commands and instance data; everything is allocated from arena, so the groups last until it is reset.
+		// Returns the number of groups, or 0 if the arena is full. modelFades is optional, for models fading between levels of detail
+		unsigned int batch(const unsigned int* modelChains, const unsigned int* modelLODs, const glm::mat4* modelMatrices, const float* modelFades,
+			const unsigned int modelCount, const glm::vec3& cameraPosition, const float farPlane, FrameArena& arena, DrawGroup*& groups);
+		void draw(const DrawGroup* groups, const unsigned int groupCount); // Fences this frame's streams once everything is submitted
+
+		void setClusterView(const ClusterView& view); // Chooses the cuts through clustered meshes for the next batches
+
+		// Takes the meshes of every level again, for when levels of detail have been loaded or evicted since
+		void setChains(const std::vector<LODChain>& chains);
+
+		bool usesIndirectDraws() const;
+
+	private:
+		struct MeshDraw
+		{
+			const Mesh* mesh;
+			unsigned int material; // Equal for meshes that share textures
+			bool clustered;
+		};
+
+		typedef void (APIENTRY* MultiDrawElementsIndirect)(GLenum mode, GLenum type, const void* indirect, GLsizei drawCount, GLsizei stride);
+
+		std::vector<unsigned int> bucketOffsets; // First bucket for each chain, with one bucket per level of detail
+		std::vector<unsigned int> bucketMeshes; // Start of each bucket's meshes in meshDraws, with one extra at the end
+		std::vector<MeshDraw> meshDraws;
+		unsigned int bucketCount = 0;
+		unsigned int maxClusterCount = 0;
+		ClusterView clusterView;
+
+		GeometryPool* pool;
+		unsigned int program; // Every command is drawn with this one
+		int normalEncodingLocation;
+		int impostorFramesLocation;
+		int impostorBoundsLocation;
+		MultiDrawElementsIndirect multiDrawElementsIndirect = nullptr; // OpenGL 4.3, so loaded by hand when available
+		StreamBuffer instanceStream; // Ring buffered across frames in flight
+		StreamBuffer* commandStream = nullptr; // Only with indirect draws
+		unsigned int attachedInstanceBuffer = 0; // The stream's buffer as last given to the pool, which changes if the stream grows
+		const DrawElementsIndirectCommand* commands = nullptr; // This frame's, for the fallback path
+		RenderQueue queue;
+};
+
+#endif
@@ -0,0 +1,50 @@
+#ifndef LOD_FADER_H
+#define LOD_FADER_H
+
+#include <glm/glm.hpp>
+
+#include <vector>
+
+#include "FrameArena.h"
+#include "GeometryPool.h"
+
+// What to submit this frame; models in the middle of a transition appear twice, once per level
+struct FadedDraws
+{
+	unsigned int* chains = nullptr;
+	unsigned int* levels = nullptr;
+	glm::mat4* matrices = nullptr;
+	float* fades = nullptr;
+	unsigned int count = 0;
+};
+
+// Cross-fades every model between its old and new level of detail over a short window instead of switching at once; both levels
+// are drawn opaque with complementary dither patterns, so nothing needs sorting or blending and the depth buffer stays intact
+class LODFader
+{
+	public:
+		LODFader(const unsigned int modelCount, const float duration);
+
+		// Starts a transition for every model whose level changed since the last update, and writes the draws for this frame into
+		// arena; returns false if the arena is full
+		bool update(const unsigned int* modelChains, const unsigned int* modelLODs, const glm::mat4* modelMatrices, const float time,
+			FrameArena& arena, FadedDraws& draws);
+
+		unsigned int getFadingCount() const; // Models that were drawn twice by the last update
+		void setDuration(const float duration); // In seconds; 0 switches levels immediately
+
+	private:
+		struct Transition
+		{
+			unsigned int from;
+			unsigned int to;
+			float start;
+		};
+
+		std::vector<Transition> transitions;
+		float duration;
+		unsigned int fadingCount = 0;
+		bool started = false; // Models start on their first levels rather than fading in from nothing
+};
+
+#endif
@@ -0,0 +1,70 @@
+#ifndef LOD_STREAMER_H
+#define LOD_STREAMER_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "Model.h"
+#include "GeometryPool.h"
+#include "ModelLoader.h"
+#include "WorkerPool.h"
+
+// Keeps streamed levels of detail resident only while they are wanted: a level is loaded on a worker the first time a model asks for
+// it, models draw the nearest resident level until it arrives, and once the resident levels take more than the budget, those drawn
+// least recently are evicted. Only geometry streams; a level's textures stay resident with the rest of its chain
+class LODStreamer
+{
+	public:
+		LODStreamer(WorkerPool& workers, const size_t budget); // Bytes of pool memory streamed levels may take
+
+		LODStreamer(const LODStreamer&) = delete;
+		LODStreamer& operator=(const LODStreamer&) = delete;
+
+		// Streams level of chains[chain] from now on, by simplifying fileName down to ratio of its triangles; the level stays as it is
+		// until evicted, so it can start out either loaded or as a placeholder without meshes. Reloaded meshes take the textures of the
+		// chain's first level that has meshes, so it must be called after textures are final, such as once they're packed into arrays
+		void addLevel(const std::vector<LODChain>& chains, const unsigned int chain, const unsigned int level, const std::string& rootPath,
+			const std::string& fileName, const unsigned int shader, const float ratio, const ImportOptions& options = ImportOptions{});
+
+		// The level itself when resident, and otherwise the nearest resident level, preferring coarser ones, while it loads
+		unsigned int resolve(const std::vector<LODChain>& chains, const unsigned int chain, const unsigned int level);
+		void markUsed(const unsigned int chain, const unsigned int level); // Levels drawn since the last update are never evicted by it
+
+		// Uploads every finished load into its chain, then evicts the least recently drawn levels until the rest fit the budget;
+		// true if any level changed, so anything holding on to the chains' meshes has to take them again
+		bool update(std::vector<LODChain>& chains, GeometryPool& geometry);
+
+		size_t getResidentBytes() const;
+		unsigned int getLoadingCount() const;
+
+	private:
+		struct StreamedLevel
+		{
+			unsigned int chain;
+			unsigned int level;
+			std::string rootPath;
+			std::string fileName;
+			unsigned int shader;
+			float ratio;
+			ImportOptions options;
+			std::vector<std::vector<Texture>> textures; // For each mesh
+			bool resident;
+			bool loading;
+			unsigned int load; // As the loader numbered it, while loading
+			size_t bytes; // While resident
+			uint64_t lastUsed;
+		};
+
+		StreamedLevel* find(const unsigned int chain, const unsigned int level);
+		bool isResident(const unsigned int chain, const unsigned int level);
+
+		ModelLoader loader;
+		std::vector<StreamedLevel> levels;
+		std::vector<std::vector<int>> slots; // Index into levels for each level of each chain, or -1 for levels that don't stream
+		size_t budget;
+		size_t residentBytes = 0;
+		uint64_t frame = 0; // Counts updates
+};
+
+#endif
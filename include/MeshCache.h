@@ -0,0 +1,56 @@
+#ifndef MESH_CACHE_H
+#define MESH_CACHE_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "Model.h"
+
+const uint32_t meshCacheVersion = 2; // Bumped whenever the layout of a cache file or of Vertex changes
+
+// A mesh as read from a file, before it is optimized and uploaded
+struct ImportedMesh
+{
+	std::string name;
+	std::vector<Vertex> vertices;
+	std::vector<unsigned int> indices;
+	std::vector<Texture> textures;
+};
+
+// Another file an import looked for, such as an OBJ's material library
+struct MeshCacheDependency
+{
+	std::string path;
+	uint64_t size = 0; // The largest value if the file didn't exist
+	int64_t time = 0;
+};
+
+// What a cache was built from; a cache is only read back if all of it still matches
+struct MeshCacheKey
+{
+	uint64_t sourceSize = 0;
+	int64_t sourceTime = 0; // Last write time of the source, in the file clock's own units
+	uint64_t settingsHash = 0; // Of every import setting that changes the result
+	std::vector<MeshCacheDependency> dependencies; // Only needed for writing, since a cache checks the ones it was written with itself
+};
+
+uint64_t hashBytes(const void* data, const size_t size, const uint64_t seed = 14695981039346656037ull); // FNV-1a
+
+// False if the source file can't be found
+bool findMeshCacheKey(const std::string& sourcePath, const uint64_t settingsHash, MeshCacheKey& key);
+
+// Records the file as it is now, or that it's missing, so the cache is rebuilt once it changes, appears or goes away
+void addMeshCacheDependency(const std::string& path, MeshCacheKey& key);
+
+// Maps the cache into memory and copies its meshes out; false if it is missing, truncated, from another version, built from anything
+// other than key or if any of its dependencies changed. Textures come back with their file and uniform, but no id, since they aren't
+// loaded yet
+bool readMeshCache(const std::string& cachePath, const MeshCacheKey& key, std::vector<ImportedMesh>& meshes);
+
+// Writes a header, the key's dependencies, a table of every texture file used, then each mesh's name, textures, vertices and indices; the header is written
+// last, and the file only replaces an existing cache once complete, so a cache that was never finished is never read. Safe to call
+// from several threads at once
+bool writeMeshCache(const std::string& cachePath, const MeshCacheKey& key, const std::vector<ImportedMesh>& meshes);
+
+#endif
@@ -0,0 +1,45 @@
+#ifndef MESH_OPTIMIZER_H
+#define MESH_OPTIMIZER_H
+
+#include <vector>
+
+#include "Vertex.h"
+
+const unsigned int simulatedCacheSize = 16; // FIFO post-transform cache used to measure ACMR, a conservative match for most GPUs
+
+// Average cache miss ratio before and after optimizeMesh, in vertices transformed per triangle; 0.5 is ideal and 3 the worst
+struct OptimizationStats
+{
+	float acmrBefore;
+	float acmrAfter;
+};
+
+// Largest difference in each attribute for two vertices to be welded into one; 0 only welds exact copies
+struct WeldTolerances
+{
+	float position = 1e-6f;
+	float normal = 1e-3f;
+	float texCoords = 1e-5f;
+};
+
+float computeACMR(const std::vector<unsigned int>& indices, const unsigned int vertexCount, const unsigned int cacheSize = simulatedCacheSize);
+
+// Reorders triangles for post-transform vertex cache reuse, using Forsyth's linear-speed algorithm
+void optimizeVertexCache(std::vector<unsigned int>& indices, const unsigned int vertexCount);
+
+// Splits an already cache-optimized triangle order into clusters, then sorts them so outward-facing clusters draw first, as in Tipsify;
+// threshold is how much worse than the original ACMR the result may get in exchange for less overdraw
+void optimizeOverdraw(std::vector<unsigned int>& indices, const std::vector<Vertex>& vertices, const float threshold = 1.05f);
+
+// Renumbers vertices in the order the indices first use them, so vertex fetches are sequential; unused vertices are removed
+void optimizeVertexFetch(std::vector<Vertex>& vertices, std::vector<unsigned int>& indices);
+
+// Merges vertices whose attributes all round to the same multiples of their tolerances and rebuilds indices to match, keeping
+// the first of each group; vertices that only differ in normal or UV are snapped to the same position so seams stay exact.
+// Returns the new vertex count
+unsigned int weldVertices(std::vector<Vertex>& vertices, std::vector<unsigned int>& indices, const WeldTolerances& tolerances = WeldTolerances{});
+
+// Runs all three passes in order; the result only depends on the input, so repeated imports give identical buffers
+OptimizationStats optimizeMesh(std::vector<Vertex>& vertices, std::vector<unsigned int>& indices);
+
+#endif
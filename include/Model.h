@@ -1,58 +1,138 @@
 #ifndef MODEL_H
 #define MODEL_H 
 
-#include <glm/vec3.hpp>
-#include <glm/vec2.hpp>
 #include <vector>
+#include <string>
 
-const unsigned int levelsOfDetail = 2;
-
-struct Vertex
-{
-	glm::vec3 position;
-	glm::vec3 normal;
-	glm::vec2 texCoords;
-};
+#include "Vertex.h"
+#include "GeometryPool.h"
+#include "ClusterHierarchy.h"
 
 struct Texture
 {
 	bool isSpecular;
 	unsigned int id;
-	const char* file;
-	const char* uniform;
+	std::string file;
+	std::string uniform;
+	bool isArray = false; // Set once the texture has been packed into a layer of a GL_TEXTURE_2D_ARRAY, which id then names
+	unsigned int layer = 0;
 
 	Texture();
-	Texture(unsigned int id, bool isSpecular, const char* file, const char* uniform);
+	Texture(unsigned int id, bool isSpecular, const char* file, const std::string& uniform);
 };
 
+const unsigned int impostorTextureUnit = 8; // Below the units unused samplers are pointed at
+
+// A mesh drawn as one camera-facing quad, textured with whichever view in its atlas was rendered from closest to the camera
+struct Impostor
+{
+	unsigned int atlas = 0; // A grid of frames by frames views, laid out by the octahedral mapping of each view's direction
+	unsigned int frames = 0; // 0 for every mesh that isn't an impostor
+	glm::vec4 bounds = glm::vec4(0.0f); // Sphere the views were framed around, center in xyz and radius in w
+};
+
+// Owns its range of a GeometryPool, so it can only be moved; the range is returned along with the mesh, so every mesh must be destroyed before its pool
 class Mesh
 {
 	public:
-		Mesh(const std::vector<Vertex>& vertices, const std::vector<unsigned int>& indices, const std::vector<Texture>& textures);
+		// Vertices and indices are freed once uploaded unless retainGeometry is set, for meshes that need to be read on the CPU later;
+		// preferredFormat is used unless the mesh can't be compacted without visible loss
+		Mesh(GeometryPool& pool, std::vector<Vertex>&& vertices, std::vector<unsigned int>&& indices, std::vector<Texture>&& textures,
+			const VertexFormat preferredFormat = VertexFormat::Octahedral, const bool retainGeometry = false);
+		~Mesh();
+
+		Mesh(const Mesh&) = delete;
+		Mesh& operator=(const Mesh&) = delete;
+		Mesh(Mesh&& other) noexcept;
+		Mesh& operator=(Mesh&& other) noexcept;
 		
-		void setup(const unsigned int shader);
-		void draw() const;
-		void cleanUp();
+		void setup(const unsigned int shader); // Again whenever the textures change
+		void bindMaterial() const; // Binds every texture to its own unit and points the shader's samplers at them
+		bool sharesMaterial(const Mesh& other) const;
+
+		bool hasGeometry() const;
+		const std::vector<Vertex>& getVertices() const; // Empty unless the mesh retained its geometry
+		const std::vector<unsigned int>& getIndices() const;
+		const GeometryRange& getRange() const;
+		const VertexQuantization& getQuantization() const; // Drawn per instance, so meshes with different bounds can share a draw
+		const std::vector<Texture>& getTextures() const;
+		std::vector<Texture>& getTextures();
+		glm::vec2 getTextureLayers() const; // Of the first diffuse and specular textures, drawn per instance like the quantization
+		// Meshes whose indices hold a cluster hierarchy are drawn as a cut through it chosen per instance, rather than in full
+		void setClusters(std::vector<Cluster>&& clusters);
+		const std::vector<Cluster>& getClusters() const; // Empty unless the mesh is clustered
+		void setImpostor(const Impostor& impostor);
+		const Impostor& getImpostor() const;
+		const VertexQuantization& getBounds() const; // Box around the vertices as its corner and size, whether or not positions are quantized
 	
 	private:
+		void release();
+
 		std::vector<Vertex> vertices;
 		std::vector<unsigned int> indices;
 		std::vector<Texture> textures;
 		std::vector<int> samplers; // Shader locations for textures
+		std::vector<Cluster> clusters;
+		Impostor impostor;
 
-		unsigned int vertexArray, vertexBuffer, elementBuffer = 0; // IDs for each
+		GeometryPool* pool = nullptr;
+		GeometryRange range;
+		VertexQuantization quantization;
+		VertexQuantization bounds;
 };
 
 class Model
 {
 	public:
-		Model(std::vector<Mesh> meshes, const unsigned int shader);
+		// geometricError is how far this model strays from the full-detail model it was simplified from, in model units
+		Model(std::vector<Mesh>&& meshes, const unsigned int shader, const float geometricError = 0.0f);
+
+		Model(const Model&) = delete;
+		Model& operator=(const Model&) = delete;
+		Model(Model&&) noexcept = default;
+		Model& operator=(Model&&) noexcept = default;
 
-		void draw() const;
-		void cleanUp(); // Seperate because cannot be called more than once as a result of local variables going out of scope; handles OpenGL clean up;
+		const std::vector<Mesh>& getMeshes() const;
+		std::vector<Mesh>& getMeshes();
+		float getGeometricError() const;
 
 	private:
 		std::vector<Mesh> meshes;
+		float geometricError;
+};
+
+// Picks which of the levels of detail up to Count to use for a detail rank; unrolled for the common counts of levels
+template<unsigned int Count>
+inline unsigned int selectLevel(const unsigned int* thresholds, const unsigned int rank)
+{
+	unsigned int level = 0;
+
+	for (unsigned int i = 0; i + 1 < Count; ++i)
+	{
+		level += rank >= thresholds[i];
+	}
+
+	return level;
+}
+
+// Every level of detail for one model, from best to worst, along with the detail ranks where each worse level takes over
+class LODChain
+{
+	public:
+		// thresholds[i] is the lowest rank to use levels[i + 1], asserted as in setThresholds; without any, each rank is one level worse up to the last
+		LODChain(std::vector<Model> levels, std::vector<unsigned int> thresholds = std::vector<unsigned int>{});
+
+		unsigned int select(const unsigned int rank) const;
+		const Model& getLevel(const unsigned int level) const;
+		Model& getLevel(const unsigned int level);
+		unsigned int getLevelCount() const;
+		void setThresholds(const std::vector<unsigned int>& thresholds); // Asserted to be ascending, with one less than the number of levels
+		void setThresholdsFromErrors(const float errorPerRank); // Each level takes over once the rank tolerates its geometric error
+		void addLevel(Model&& level, const unsigned int threshold); // Worse than every level so far, taking over from threshold on
+
+	private:
+		std::vector<Model> levels;
+		std::vector<unsigned int> thresholds;
 };
 
 #endif
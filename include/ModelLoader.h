@@ -0,0 +1,80 @@
+#ifndef MODEL_LOADER_H
+#define MODEL_LOADER_H
+
+#include <deque>
+#include <mutex>
+#include <string>
+#include <vector>
+#include <condition_variable>
+
+#include "Model.h"
+#include "GeometryPool.h"
+#include "MeshOptimizer.h"
+#include "ClusterHierarchy.h"
+#include "WorkerPool.h"
+
+// Choices for how a ModelLoader prepares each mesh it imports
+struct ImportOptions
+{
+	VertexFormat vertexFormat = VertexFormat::Octahedral; // Used for every mesh small enough to compact without visible loss
+	bool retainGeometry = false; // Keep vertices and indices in memory after upload, for anything that has to read them on the CPU
+	bool weld = true; // Merge duplicate vertices, which formats like OBJ write once per face corner
+	WeldTolerances weldTolerances;
+	bool optimize = true; // Reorder triangles and vertices for the vertex cache, overdraw and vertex fetch
+	float simplificationError = 0.02f; // Most a generated level of detail may stray from the full mesh, relative to the mesh's size
+	bool buildClusters = false; // Split meshes into a hierarchy of clusters, so each instance picks its own detail for every part of it
+	ClusterOptions clusterOptions;
+};
+
+// Loads models across a WorkerPool: files are parsed, meshes welded, simplified and optimized, and textures decoded on workers, one
+// task per mesh and per texture, leaving only uploads to the thread owning the GL context
+class ModelLoader
+{
+	public:
+		ModelLoader(WorkerPool& workers);
+		~ModelLoader(); // Waits for loads still running, and drops any never uploaded
+
+		ModelLoader(const ModelLoader&) = delete;
+		ModelLoader& operator=(const ModelLoader&) = delete;
+
+		// Both start loading right away, and return where the chain will be in what finish returns; a model loads as a chain of one level
+		unsigned int queueModel(const std::string& rootPath, const std::string& fileName, const unsigned int shader, const ImportOptions& options = ImportOptions{});
+
+		// Generates a level of detail for each ratio of the full triangle count by simplifying every mesh in the file; each level
+		// records its geometric error, and the chain's thresholds are derived from those errors
+		unsigned int queueLODChain(const std::string& rootPath, const std::string& fileName, const unsigned int shader, const std::vector<float>& ratios,
+			const float errorPerRank, const ImportOptions& options = ImportOptions{});
+
+		// Generates one level of detail at ratio of the full triangle count, with meshTextures[i] as the textures of its ith mesh instead
+		// of loading them again, so a level can be reloaded into a chain whose textures are already resident
+		unsigned int queueLevel(const std::string& rootPath, const std::string& fileName, const unsigned int shader, const float ratio,
+			const std::vector<std::vector<Texture>>& meshTextures, const ImportOptions& options = ImportOptions{});
+
+		// Uploads each load as soon as its workers are done with it, so uploads overlap the loads still running; must be called on the
+		// GL thread, and returns every chain queued since the last call in the order they were queued
+		std::vector<LODChain> finish(GeometryPool& geometry);
+
+		// Uploads one finished load, if any, without waiting; a loader should be drained with either poll or finish, not both. Gives the
+		// number queueModel, queueLODChain or queueLevel returned for it, which may be given out again once every load has been polled
+		bool poll(GeometryPool& geometry, unsigned int& load, std::vector<Model>& levels);
+		unsigned int getPendingCount() const; // Loads not yet uploaded
+
+	private:
+		struct Load;
+
+		unsigned int queue(Load* load);
+		void import(Load* load);
+		void decodeTexture(Load* load, const unsigned int texture);
+		void prepareMesh(Load* load, const unsigned int mesh);
+		void complete(Load* load);
+		std::vector<Model> upload(Load& load, GeometryPool& geometry) const;
+
+		WorkerPool& workers;
+		std::vector<Load*> loads;
+		std::deque<unsigned int> ready; // Loads whose workers are all done, waiting to be uploaded
+		std::mutex mutex;
+		std::condition_variable completed;
+		unsigned int pending = 0;
+};
+
+#endif
@@ -0,0 +1,100 @@
+#ifndef MORTON_H
+#define MORTON_H
+
+#include <glm/glm.hpp>
+
+#include <cstdint>
+#include <algorithm>
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+#include "AABB.h"
+#include "Octree.h"
+
+// Morton codes interleave x, y and z cell bits three to a level, most significant level first, so two codes share a
+// prefix for as many levels as they share octants in the octree; only 21 levels fit in 64 bits
+static_assert(maxDepth <= 21, "Morton codes can only hold 21 octree levels");
+
+static constexpr unsigned int mortonBits = 3 * maxDepth;
+
+struct MortonTable
+{
+	unsigned char ranks[maxDepth][8]; // Detail rank indexed by the first level two codes differ at, then the bits that differ there
+};
+
+static constexpr MortonTable buildMortonTable()
+{
+	MortonTable table = {};
+
+	// The camera's octant is taken as octant 0 (no bits set), so the differing bits select the other octant
+	for (unsigned int level = 0; level < maxDepth; ++level)
+	{
+		for (unsigned int bits = 0; bits < 8; ++bits)
+		{
+			table.ranks[level][bits] = octantTable.ranks[level][0][octantTable.fromBits[bits]];
+		}
+	}
+
+	return table;
+}
+
+static constexpr MortonTable mortonTable = buildMortonTable();
+
+static inline unsigned int countLeadingZeros(const uint64_t value)
+{
+#ifdef _MSC_VER
+	unsigned long index;
+	_BitScanReverse64(&index, value);
+	return 63 - index;
+#else
+	return __builtin_clzll(value);
+#endif
+}
+
+// Spreads the lowest 21 bits of value out so there are two zero bits between each
+static inline uint64_t spreadBits(uint64_t value)
+{
+	value &= 0x1fffff;
+	value = (value | value << 32) & 0x1f00000000ffff;
+	value = (value | value << 16) & 0x1f0000ff0000ff;
+	value = (value | value << 8) & 0x100f00f00f00f00f;
+	value = (value | value << 4) & 0x10c30c30c30c30c3;
+	value = (value | value << 2) & 0x1249249249249249;
+	return value;
+}
+
+// Positions outside of the scene are clamped to its border cells, the same as the octree treats them
+static uint64_t encodeMorton(const AABB& sceneBox, const glm::vec3& position)
+{
+	const float cells = static_cast<float>(1u << maxDepth);
+	const glm::vec3 scaled = (position - sceneBox.min) / (sceneBox.max - sceneBox.min) * cells;
+	uint64_t code = 0;
+
+	for (unsigned int axis = 0; axis < 3; ++axis)
+	{
+		const float cell = std::min(std::max(scaled[axis], 0.0f), cells - 1.0f);
+		code |= spreadBits(static_cast<uint64_t>(cell)) << axis;
+	}
+
+	return code;
+}
+
+// Same result as findLevelsOfDetail, but from the common prefix of each model's code with the camera's, so there is no
+// tree traversal and no branching; the loop body is simple enough for the compiler to vectorize
+static void classifyLevelsOfDetail(const uint64_t* modelCodes, const unsigned int modelCount, const uint64_t cameraCode, unsigned int* modelRanks)
+{
+	for (unsigned int i = 0; i < modelCount; ++i)
+	{
+		// Setting the lowest bit keeps count leading zeros defined; it can only land in the deepest level, which always has the best rank
+		const uint64_t difference = (modelCodes[i] ^ cameraCode) | 1;
+		const unsigned int highestBit = 63 - countLeadingZeros(difference);
+		const unsigned int level = (mortonBits - 1 - highestBit) / 3;
+		const unsigned int bits = (difference >> (highestBit - highestBit % 3)) & 7;
+
+		modelRanks[i] = mortonTable.ranks[level][bits];
+	}
+}
+
+#endif
@@ -7,9 +7,53 @@
 #include <cmath>
 
 #include "AABB.h"
-#include "Model.h"
 
-const unsigned int maxDepth = levelsOfDetail;
+// Tuned for spatial performance alone; each model's LODChain decides how detail ranks map to its own levels of detail
+const unsigned int maxDepth = 2;
+const unsigned int leafInlineCapacity = 4; // Leaves with this many models or fewer keep them inline instead of in the shared array
+
+struct OctantTable
+{
+	unsigned char fromBits[8]; // Octant index from x | y << 1 | z << 2, where each bit is set on the positive side of the center
+	unsigned char bits[8]; // Inverse of fromBits
+	unsigned char relations[8][8]; // Axes two octants differ on: 0 for the same octant, 1 face-adjacent, 2 edge-adjacent, 3 corner-diagonal
+	unsigned char ranks[maxDepth][8][8]; // Detail rank for an octant at a given depth, indexed by the camera's octant then the other octant
+};
+
+static constexpr OctantTable buildOctantTable()
+{
+	// Octants are defined in clockwise order from the bottom-left, matching build below
+	OctantTable table = { { 0, 1, 4, 5, 3, 2, 7, 6 }, { 0, 1, 5, 4, 2, 3, 7, 6 }, {}, {} };
+
+	for (unsigned int i = 0; i < 8; ++i)
+	{
+		for (unsigned int j = 0; j < 8; ++j)
+		{
+			const unsigned int difference = table.bits[i] ^ table.bits[j];
+			table.relations[i][j] = (difference & 1) + (difference >> 1 & 1) + (difference >> 2 & 1);
+		}
+	}
+
+	// Each level further from the camera's terminal branch ranks worse than any relation at the level below it, and
+	// everything within the terminal branch, the last depth, gets the best rank
+	for (unsigned int depth = 0; depth + 1 < maxDepth; ++depth)
+	{
+		const unsigned int levelOffset = 3 * (maxDepth - 2 - depth);
+
+		for (unsigned int i = 0; i < 8; ++i)
+		{
+			for (unsigned int j = 0; j < 8; ++j)
+			{
+				const unsigned int relation = table.relations[i][j];
+				table.ranks[depth][i][j] = relation == 0 ? 0 : levelOffset + relation;
+			}
+		}
+	}
+
+	return table;
+}
+
+static constexpr OctantTable octantTable = buildOctantTable();
 
 struct Node
 {
@@ -31,17 +75,45 @@ struct Branch : Node
 
 struct Leaf : Node
 {
-	std::vector<unsigned int> models; // Contains the indices for models within this node
+	unsigned int count; // Number of models within this node
+
+	union
+	{
+		unsigned int offset; // Start of this leaf's range within the shared index array
+		unsigned int inlineModels[leafInlineCapacity];
+	};
+
+	// Appends to leafModels only when the models don't fit in the inline buffer
+	Leaf(const AABB& boundingBox, const std::vector<unsigned int>& models, std::vector<unsigned int>& leafModels)
+		: Node(boundingBox), count(static_cast<unsigned int>(models.size()))
+	{
+		if (count <= leafInlineCapacity)
+		{
+			for (unsigned int i = 0; i < count; ++i)
+			{
+				inlineModels[i] = models[i];
+			}
+		}
+		else
+		{
+			offset = static_cast<unsigned int>(leafModels.size());
+			leafModels.insert(leafModels.end(), models.begin(), models.end());
+		}
+	}
 
-	Leaf(const AABB& boundingBox, const std::vector<unsigned int>& models) : Node(boundingBox), models(models) {}
+	// Contains the indices for models within this node
+	const unsigned int* getModels(const unsigned int* leafModels) const
+	{
+		return count <= leafInlineCapacity ? inlineModels : leafModels + offset;
+	}
 };
 
-// Assumes origin is at zero
-static Node* build(const AABB& bbox, const std::vector<unsigned int>& models, const glm::vec3* modelPositions, const unsigned int modelCount, const unsigned int depth)
+// Assumes origin is at zero; leafModels is the index array shared by every leaf in the tree
+static Node* build(const AABB& bbox, const std::vector<unsigned int>& models, const glm::vec3* modelPositions, const unsigned int modelCount, const unsigned int depth, std::vector<unsigned int>& leafModels)
 {
 	if (depth >= maxDepth)
 	{
-		return new Leaf(bbox, models);
+		return new Leaf(bbox, models, leafModels);
 	}
 
 	Branch* current = new Branch(bbox);
@@ -77,7 +149,7 @@ static Node* build(const AABB& bbox, const std::vector<unsigned int>& models, co
 
 	for (unsigned int i = 0; i < 8; ++i)
 	{
-		current->children[i] = build(octants[i], nextModels[i], modelPositions, modelCount, depth + 1);
+		current->children[i] = build(octants[i], nextModels[i], modelPositions, modelCount, depth + 1, leafModels);
 	}
 
 	return current;
@@ -85,9 +157,9 @@ static Node* build(const AABB& bbox, const std::vector<unsigned int>& models, co
 
 static void destructNode(Node* node, const unsigned int depth)
 {
-	if (depth == maxDepth - 1)
+	if (depth >= maxDepth)
 	{
-		delete node;
+		delete (Leaf*)node;
 	}
 	else
 	{
@@ -98,63 +170,71 @@ static void destructNode(Node* node, const unsigned int depth)
             destructNode(current->children[i], depth + 1);
         }
 
-        delete node;
+        delete[] current->children;
+        delete current;
 	}
 }
 
-static void setLevelsOfDetail(Branch* terminalBranch, unsigned int* modelLODs, const unsigned int levelOfDetail)
+// Sets every model in the subtree under node, which sits at the given depth, to the same detail rank
+static void setLevelsOfDetail(const Node* node, const unsigned int depth, const unsigned int* leafModels, unsigned int* modelRanks, const unsigned int rank)
 {
-	for (unsigned int i = 0; i < 8; ++i)
+	if (depth >= maxDepth)
 	{
-		Leaf* current = (Leaf*)terminalBranch->children[i];
-		const std::vector<unsigned int> models = current->models;
+		const Leaf* leaf = (const Leaf*)node;
+		const unsigned int* models = leaf->getModels(leafModels);
 
-		for (unsigned int j = 0; j < models.size(); ++j)
+		for (unsigned int i = 0; i < leaf->count; ++i)
 		{
-			modelLODs[models[j]] = levelOfDetail;
+			modelRanks[models[i]] = rank;
 		}
+
+		return;
 	}
+
+	const Branch* branch = (const Branch*)node;
+
+	for (unsigned int i = 0; i < 8; ++i)
+	{
+		setLevelsOfDetail(branch->children[i], depth + 1, leafModels, modelRanks, rank);
+	}
+}
+
+// Calculate a number from 0 to 7 that will choose the octant of a branch centered at center where position resides
+static unsigned int findOctant(const glm::vec3& center, const glm::vec3& position)
+{
+	const unsigned int bits =
+		(unsigned int)!std::signbit(position.x - center.x) |
+		(unsigned int)!std::signbit(position.y - center.y) << 1 |
+		(unsigned int)!std::signbit(position.z - center.z) << 2;
+
+	return octantTable.fromBits[bits];
 }
 
-static void findLevelsOfDetail(Node* const root, unsigned int* modelLODs, const glm::vec3& cameraPosition)
+// Fills modelRanks with a detail rank for every model: 0 within the camera's terminal branch, increasing the further away its octant is
+static void findLevelsOfDetail(Node* const root, const unsigned int* leafModels, unsigned int* modelRanks, const glm::vec3& cameraPosition)
 {
 	Node* current = root;
-	unsigned int worstDetail = maxDepth - 1;
 
-	for (unsigned int level = worstDetail; level > 0; --level)
+	// Branches above the one holding the camera's leaves; the camera's terminal branch always gets the best level of detail
+	for (unsigned int depth = 0; depth + 1 < maxDepth; ++depth)
 	{
 		Branch* node = (Branch*)current;
-		glm::vec3 center = node->boundingBox.center;
-		
-		// Calculate a number from 0 to 7 that will choose the correct octant where the camera resides
-		short xDifference = !std::signbit(cameraPosition.x - center.x);
-		short yDifference = !std::signbit(cameraPosition.y - center.y) * 4;
-		short zDifference = !std::signbit(cameraPosition.z - center.z);
-		zDifference = zDifference + 2 * (1 - xDifference);
-		short nextChild = xDifference + yDifference + zDifference;
-
-		current = node->children[nextChild];
-
-		// For the remaining octants that aren't chosen, their models will be left with a worse level of detail 
+		const unsigned int cameraOctant = findOctant(node->boundingBox.center, cameraPosition);
+		const unsigned char* octantRanks = octantTable.ranks[depth][cameraOctant];
+
+		// For the remaining octants that aren't chosen, their models will be left with a worse rank depending on how they neighbor the camera's octant
 		for (unsigned int i = 0; i < 8; ++i)
 		{
-			if (i == nextChild)
+			if (i != cameraOctant)
 			{
-				continue;
+				setLevelsOfDetail(node->children[i], depth + 1, leafModels, modelRanks, octantRanks[i]);
 			}
-
-			Branch* next = node;
-
-			for (unsigned int j = level; j > 0; --j)
-			{
-				next = (Branch*)next->children[i];
-			}
-
-			setLevelsOfDetail(next, modelLODs, level);
 		}
+
+		current = node->children[cameraOctant];
 	}
 
-	setLevelsOfDetail((Branch*)current, modelLODs, 0);
+	setLevelsOfDetail(current, maxDepth - 1, leafModels, modelRanks, 0);
 }
 
 #endif
@@ -0,0 +1,45 @@
+#ifndef RENDER_QUEUE_H
+#define RENDER_QUEUE_H
+
+#include <cstdint>
+
+#include "FrameArena.h"
+
+// Sort key fields from most to least significant, so sorting by key groups draws by the state most expensive to change
+const unsigned int sortKeyProgramBits = 8;
+const unsigned int sortKeyMaterialBits = 16;
+const unsigned int sortKeyVertexArrayBits = 8; // Vertex format, then index size
+const unsigned int sortKeyDepthBits = 24;
+
+// Packs draw state and a depth from 0 at the camera to 1 at the far plane; nearer draws sort first within the same state, so they
+// fill the depth buffer before anything behind them
+uint64_t makeSortKey(const unsigned int program, const unsigned int material, const unsigned int vertexArray, const float depth);
+
+// True when two keys share every field but depth, so their draws need no state change in between
+inline bool sharesDrawState(const uint64_t a, const uint64_t b)
+{
+	return (a >> sortKeyDepthBits) == (b >> sortKeyDepthBits);
+}
+
+// Items pushed with a sort key each frame and radix sorted by it; storage comes from a FrameArena, so it lasts until the arena is reset
+class RenderQueue
+{
+	public:
+		bool begin(FrameArena& arena, const unsigned int capacity); // False if the arena is full
+		void push(const uint64_t key, const unsigned int item);
+		void sort(); // Stable, so items with equal keys keep the order they were pushed in
+
+		unsigned int getCount() const;
+		const uint64_t* getKeys() const;
+		const unsigned int* getItems() const;
+
+	private:
+		uint64_t* keys = nullptr;
+		unsigned int* items = nullptr;
+		uint64_t* scratchKeys = nullptr;
+		unsigned int* scratchItems = nullptr;
+		unsigned int count = 0;
+		unsigned int capacity = 0;
+};
+
+#endif
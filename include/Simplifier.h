@@ -0,0 +1,23 @@
+#ifndef SIMPLIFIER_H
+#define SIMPLIFIER_H
+
+#include <vector>
+
+#include "Vertex.h"
+
+// One simplified level of detail; indices still refer to the vertices it was simplified from
+struct SimplifiedLevel
+{
+	std::vector<unsigned int> indices;
+	float error; // Root mean square distance from the original surface, in model units
+};
+
+// Collapses edges in order of quadric error until the mesh is down to targetIndexCount indices or the next collapse would exceed
+// targetError. Vertices only ever move onto neighboring vertices, so attributes stay valid; vertices on open borders are locked,
+// and vertices on UV seams only collapse along the seam, both sides at once, so seams stay closed
+SimplifiedLevel simplifyMesh(const std::vector<Vertex>& vertices, const std::vector<unsigned int>& indices, const unsigned int targetIndexCount, const float targetError);
+
+// One level per ratio of the original triangle count, each simplified from the full mesh so its error is measured against it
+std::vector<SimplifiedLevel> generateLevelsOfDetail(const std::vector<Vertex>& vertices, const std::vector<unsigned int>& indices, const std::vector<float>& ratios, const float maxError);
+
+#endif
@@ -0,0 +1,46 @@
+#ifndef STREAM_BUFFER_H
+#define STREAM_BUFFER_H
+
+#include <glad/glad.h>
+
+#include <cstddef>
+
+const unsigned int streamFrameCount = 3; // Frames the CPU may write ahead of the GPU before waiting on it
+
+// A buffer split into one region per frame in flight, each guarded by a fence so nothing the GPU may still be reading is overwritten.
+// Regions stay persistently mapped where glBufferStorage is available, and are otherwise mapped unsynchronized each frame; must be
+// destroyed while the context exists
+class StreamBuffer
+{
+	public:
+		// Regions start with room for regionSize bytes and grow as needed; alignment is what every region's offset must be a multiple of
+		StreamBuffer(const GLenum target, const size_t regionSize, const size_t alignment = 1);
+		~StreamBuffer();
+
+		StreamBuffer(const StreamBuffer&) = delete;
+		StreamBuffer& operator=(const StreamBuffer&) = delete;
+
+		// Waits until the GPU is done with this frame's region and returns it for writing size bytes; the buffer is replaced when
+		// size doesn't fit, so its name can change
+		void* map(const size_t size);
+		void unmap(); // Must come before drawing from the region
+		void fence(); // Call once this frame's draws are submitted, to move on to the next region
+
+		unsigned int getBuffer() const;
+		size_t getOffset() const; // Of this frame's region, in bytes
+		bool isPersistent() const;
+
+	private:
+		void allocate(const size_t regionSize);
+		void waitForRegion(const unsigned int region);
+
+		GLenum target;
+		size_t alignment;
+		size_t regionSize = 0;
+		unsigned int buffer = 0;
+		unsigned int region = 0;
+		unsigned char* persistentData = nullptr;
+		GLsync fences[streamFrameCount] = {};
+};
+
+#endif
@@ -0,0 +1,13 @@
+#ifndef TEXTURE_ARRAY_H
+#define TEXTURE_ARRAY_H
+
+#include <vector>
+
+#include "Model.h"
+
+// Moves every material texture used by chains into layers of GL_TEXTURE_2D_ARRAYs, one per texture size, then points each mesh at
+// its arrays and layers and sets it up again with shader; meshes whose textures only differ in layers then share a material.
+// Samplers are renamed from texture_ to textureArray_, so shader must declare both. Returns the number of arrays created
+unsigned int packTextureArrays(std::vector<LODChain>& chains, const unsigned int shader);
+
+#endif
@@ -0,0 +1,53 @@
+#ifndef VERTEX_H
+#define VERTEX_H
+
+#include <glm/vec3.hpp>
+#include <glm/vec2.hpp>
+#include <vector>
+
+struct Vertex
+{
+	glm::vec3 position;
+	glm::vec3 normal;
+	glm::vec2 texCoords;
+};
+
+// How a mesh's vertices are laid out on the GPU; each format has its own vertex array in a GeometryPool and is decoded in shader.vs
+enum class VertexFormat : unsigned char
+{
+	Full, // Vertex as is, 32 bytes
+	Octahedral, // CompactVertex with octahedral normals in 2 x 16 bits
+	Packed // CompactVertex with normals in 10:10:10:2
+};
+
+const unsigned int vertexFormatCount = 3;
+
+// 16 bytes, half of Vertex
+struct CompactVertex
+{
+	unsigned short position[4]; // Normalized within the mesh's bounds; the last is padding
+	unsigned int normal;
+	unsigned short texCoords[2]; // Half floats
+};
+
+static_assert(sizeof(CompactVertex) == 16, "CompactVertex should have no padding");
+
+// Positions are decoded in the shader as offset + scale * position
+struct VertexQuantization
+{
+	glm::vec3 offset = glm::vec3(0.0f);
+	glm::vec3 scale = glm::vec3(1.0f);
+};
+
+unsigned int getVertexStride(const VertexFormat format);
+VertexQuantization findQuantization(const std::vector<Vertex>& vertices);
+VertexFormat chooseVertexFormat(const std::vector<Vertex>& vertices, const VertexQuantization& quantization, const VertexFormat preferred);
+
+// Returns the raw bytes to upload for vertices in the given format
+std::vector<unsigned char> encodeVertices(const std::vector<Vertex>& vertices, const VertexFormat format, const VertexQuantization& quantization);
+
+unsigned short encodeHalf(const float value);
+unsigned int encodeOctahedral(const glm::vec3& normal);
+unsigned int encodePacked(const glm::vec3& normal);
+
+#endif
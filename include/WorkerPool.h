@@ -0,0 +1,35 @@
+#ifndef WORKER_POOL_H
+#define WORKER_POOL_H
+
+#include <deque>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <functional>
+#include <condition_variable>
+
+// Runs tasks on a fixed set of threads, in the order they were submitted; tasks may submit more tasks, and must never touch OpenGL
+class WorkerPool
+{
+	public:
+		// With no count given, uses one thread per core other than the one the GL context lives on
+		WorkerPool(unsigned int threadCount = 0);
+		~WorkerPool(); // Finishes every task already submitted before joining
+
+		WorkerPool(const WorkerPool&) = delete;
+		WorkerPool& operator=(const WorkerPool&) = delete;
+
+		void submit(std::function<void()> task);
+		unsigned int getThreadCount() const;
+
+	private:
+		void run();
+
+		std::vector<std::thread> threads;
+		std::deque<std::function<void()>> tasks;
+		std::mutex mutex;
+		std::condition_variable available;
+		bool stopping = false;
+};
+
+#endif
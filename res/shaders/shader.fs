@@ -3,6 +3,8 @@
 out vec4 color;
 
 in vec2 texCoord;
+flat in vec2 textureLayers;
+flat in float fade; // 1 when opaque; while changing level of detail, positive for the incoming level and negative for the outgoing one
 
 uniform sampler2D texture_diffuse1;
 uniform sampler2D texture_diffuse2;
@@ -10,7 +12,46 @@ uniform sampler2D texture_diffuse3;
 uniform sampler2D texture_specular1;
 uniform sampler2D texture_specular2;
 
+// Used instead when material textures are packed into arrays, with each instance's layers
+uniform bool textureArrays;
+uniform sampler2DArray textureArray_diffuse1;
+uniform sampler2DArray textureArray_specular1;
+
+// Impostors read their atlas instead, which already holds the shaded model and is transparent around it
+uniform int impostorFrames;
+uniform sampler2D impostorAtlas;
+
+// Ordered dither thresholds; fading levels keep complementary parts of the pattern, so every pixel is covered by exactly one
+const float bayer[16] = float[](0.0, 8.0, 2.0, 10.0, 12.0, 4.0, 14.0, 6.0, 3.0, 11.0, 1.0, 9.0, 15.0, 7.0, 13.0, 5.0);
+
 void main()
 {
-    color = mix(texture(texture_diffuse1, texCoord), texture(texture_specular1, texCoord), 0.5);    
+    ivec2 pixel = ivec2(gl_FragCoord.xy) & 3;
+    float threshold = (bayer[pixel.y * 4 + pixel.x] + 0.5) / 16.0;
+
+    if (fade > 0.0 ? threshold >= fade : threshold < -fade)
+    {
+        discard;
+    }
+
+    if (impostorFrames > 0)
+    {
+        color = texture(impostorAtlas, texCoord);
+
+        if (color.a < 0.5)
+        {
+            discard;
+        }
+
+        return;
+    }
+
+    if (textureArrays)
+    {
+        color = mix(texture(textureArray_diffuse1, vec3(texCoord, textureLayers.x)), texture(textureArray_specular1, vec3(texCoord, textureLayers.y)), 0.5);
+    }
+    else
+    {
+        color = mix(texture(texture_diffuse1, texCoord), texture(texture_specular1, texCoord), 0.5);
+    }
 };
\ No newline at end of file
@@ -1,17 +1,87 @@
 #version 330 core
 
 layout (location = 0) in vec3 position;
-layout (location = 1) in vec3 normal;
+layout (location = 1) in vec4 _normal;
 layout (location = 2) in vec2 _texCoord;
+// Per instance; compact vertex formats store positions normalized within the mesh's bounds, decoded with positionOffset and positionScale,
+// whose w components are the diffuse and specular layers when textures are packed into arrays
+layout (location = 3) in mat4 model;
+layout (location = 7) in vec4 positionOffset;
+layout (location = 8) in vec4 positionScale;
+layout (location = 9) in float _fade;
 
 out vec2 texCoord;
+out vec3 normal;
+flat out vec2 textureLayers;
+flat out float fade;
 
-uniform mat4 model;
-uniform mat4 view;
-uniform mat4 projection;
+layout (std140) uniform Camera
+{
+    mat4 view;
+    mat4 projection;
+    vec4 cameraPosition;
+};
+
+// Compact vertex formats store normals either octahedral or 10:10:10:2
+uniform int normalEncoding; // 0 for full precision, 1 for octahedral, 2 for 10:10:10:2
+
+// Impostors are a quad facing the camera, with corners from texture coordinates, textured with a grid of views of the model
+uniform int impostorFrames; // Views along each side of the atlas, 0 for anything that isn't an impostor
+uniform vec4 impostorBounds; // Sphere the views were framed around, center in xyz and radius in w
+
+vec3 decodeNormal(vec4 encoded)
+{
+    if (normalEncoding == 1)
+    {
+        vec3 n = vec3(encoded.xy, 1.0 - abs(encoded.x) - abs(encoded.y));
+        float t = max(-n.z, 0.0);
+        n.x += n.x >= 0.0 ? -t : t;
+        n.y += n.y >= 0.0 ? -t : t;
+        return normalize(n);
+    }
+
+    return normalize(encoded.xyz);
+}
+
+// Matches encodeViewDirection in ImpostorBuilder.cpp
+vec2 encodeViewDirection(vec3 direction)
+{
+    vec3 d = direction / (abs(direction.x) + abs(direction.y) + abs(direction.z));
+    vec2 p = d.xz;
+
+    if (d.y < 0.0)
+    {
+        p = (1.0 - abs(p.yx)) * vec2(p.x >= 0.0 ? 1.0 : -1.0, p.y >= 0.0 ? 1.0 : -1.0);
+    }
+
+    return p * 0.5 + 0.5;
+}
 
 void main()
 {
-    gl_Position = projection * view * model * vec4(position, 1.0);
+    textureLayers = vec2(positionOffset.w, positionScale.w);
+    fade = _fade;
+
+    if (impostorFrames > 0)
+    {
+        // Transposing the model matrix undoes its rotation, and the direction is normalized after, so uniform scales are fine
+        vec3 center = impostorBounds.xyz;
+        vec3 toCamera = normalize(transpose(mat3(model)) * (cameraPosition.xyz - (model * vec4(center, 1.0)).xyz));
+        vec2 frame = min(floor(encodeViewDirection(toCamera) * float(impostorFrames)), vec2(float(impostorFrames - 1)));
+
+        // Same basis the views were rendered with
+        vec3 upReference = abs(toCamera.y) > 0.999 ? vec3(0.0, 0.0, 1.0) : vec3(0.0, 1.0, 0.0);
+        vec3 right = normalize(cross(upReference, toCamera));
+        vec3 up = cross(toCamera, right);
+        vec2 corner = _texCoord * 2.0 - 1.0;
+
+        gl_Position = projection * view * model * vec4(center + (corner.x * right + corner.y * up) * impostorBounds.w, 1.0);
+        texCoord = (frame + _texCoord) / float(impostorFrames);
+        normal = mat3(model) * toCamera;
+        return;
+    }
+
+    gl_Position = projection * view * model * vec4(positionOffset.xyz + positionScale.xyz * position, 1.0);
     texCoord = _texCoord;
+    normal = mat3(model) * decodeNormal(_normal);
 };
@@ -0,0 +1,628 @@
+#include <glm/glm.hpp>
+
+#include <cmath>
+#include <cstring>
+#include <cstdint>
+#include <limits>
+#include <algorithm>
+#include <unordered_map>
+
+#include "ClusterHierarchy.h"
+#include "Simplifier.h"
+
+struct ClusterPositionHash
+{
+	size_t operator()(const glm::vec3& position) const
+	{
+		unsigned int bits[3];
+		std::memcpy(bits, &position, sizeof(bits));
+		return (bits[0] * 73856093u) ^ (bits[1] * 19349663u) ^ (bits[2] * 83492791u);
+	}
+};
+
+static uint64_t edgeKey(unsigned int a, unsigned int b)
+{
+	if (a > b)
+	{
+		std::swap(a, b);
+	}
+
+	return static_cast<uint64_t>(a) << 32 | b;
+}
+
+static glm::vec4 findBounds(const std::vector<Vertex>& vertices, const unsigned int* indices, const unsigned int indexCount)
+{
+	glm::vec3 minimum(std::numeric_limits<float>::max()), maximum(-std::numeric_limits<float>::max());
+
+	for (unsigned int i = 0; i < indexCount; ++i)
+	{
+		minimum = glm::min(minimum, vertices[indices[i]].position);
+		maximum = glm::max(maximum, vertices[indices[i]].position);
+	}
+
+	const glm::vec3 center = (minimum + maximum) * 0.5f;
+	float radius = 0.0f;
+
+	for (unsigned int i = 0; i < indexCount; ++i)
+	{
+		radius = std::max(radius, glm::distance(center, vertices[indices[i]].position));
+	}
+
+	return glm::vec4(center, radius);
+}
+
+// Smallest sphere around both spheres
+static glm::vec4 mergeBounds(const glm::vec4& a, const glm::vec4& b)
+{
+	const glm::vec3 offset = glm::vec3(b) - glm::vec3(a);
+	const float distance = glm::length(offset);
+
+	if (distance + b.w <= a.w)
+	{
+		return a;
+	}
+
+	if (distance + a.w <= b.w)
+	{
+		return b;
+	}
+
+	const float radius = (distance + a.w + b.w) * 0.5f;
+	return glm::vec4(glm::vec3(a) + offset * ((radius - a.w) / distance), radius);
+}
+
+// Grows clusters one triangle at a time from a seed, always taking the neighboring triangle nearest the cluster's center that still
+// fits; triangles are neighbors when they share a position, so clusters carry on across UV seams. Appends the triangles of each
+// cluster to clusterIndices, and the end of each cluster to clusterEnds
+static void partitionTriangles(const std::vector<Vertex>& vertices, const std::vector<unsigned int>& positionIds, const std::vector<unsigned int>& indices,
+	const ClusterOptions& options, std::vector<unsigned int>& clusterIndices, std::vector<unsigned int>& clusterEnds)
+{
+	const unsigned int triangleCount = static_cast<unsigned int>(indices.size() / 3);
+	const unsigned int vertexCount = static_cast<unsigned int>(vertices.size());
+
+	// Triangles around each position, in compressed rows
+	std::vector<unsigned int> adjacencyStarts(vertexCount + 1, 0);
+	std::vector<unsigned int> adjacency(indices.size());
+
+	for (unsigned int i = 0; i < indices.size(); ++i)
+	{
+		adjacencyStarts[positionIds[indices[i]] + 1]++;
+	}
+
+	for (unsigned int i = 0; i < vertexCount; ++i)
+	{
+		adjacencyStarts[i + 1] += adjacencyStarts[i];
+	}
+
+	std::vector<unsigned int> adjacencyFill(adjacencyStarts.begin(), adjacencyStarts.end() - 1);
+
+	for (unsigned int i = 0; i < indices.size(); ++i)
+	{
+		adjacency[adjacencyFill[positionIds[indices[i]]]++] = i / 3;
+	}
+
+	std::vector<glm::vec3> centroids(triangleCount);
+
+	for (unsigned int i = 0; i < triangleCount; ++i)
+	{
+		centroids[i] = (vertices[indices[i * 3]].position + vertices[indices[i * 3 + 1]].position + vertices[indices[i * 3 + 2]].position) / 3.0f;
+	}
+
+	// Stamped with the cluster being built, so nothing needs clearing between clusters
+	std::vector<unsigned int> vertexStamps(vertexCount, 0);
+	std::vector<unsigned int> candidateStamps(triangleCount, 0);
+	std::vector<bool> assigned(triangleCount, false);
+	std::vector<unsigned int> candidates;
+	unsigned int seed = 0;
+	unsigned int stamp = 0;
+
+	while (true)
+	{
+		while (seed < triangleCount && assigned[seed])
+		{
+			seed++;
+		}
+
+		if (seed == triangleCount)
+		{
+			break;
+		}
+
+		stamp++;
+		candidates.clear();
+		unsigned int clusterTriangles = 0;
+		unsigned int clusterVertices = 0;
+		glm::vec3 centroidSum(0.0f);
+		unsigned int next = seed;
+
+		while (true)
+		{
+			assigned[next] = true;
+			clusterTriangles++;
+			centroidSum += centroids[next];
+
+			for (unsigned int k = 0; k < 3; ++k)
+			{
+				const unsigned int vertex = indices[next * 3 + k];
+				clusterIndices.push_back(vertex);
+
+				if (vertexStamps[vertex] != stamp)
+				{
+					vertexStamps[vertex] = stamp;
+					clusterVertices++;
+				}
+
+				const unsigned int position = positionIds[vertex];
+
+				for (unsigned int j = adjacencyStarts[position]; j < adjacencyStarts[position + 1]; ++j)
+				{
+					const unsigned int neighbor = adjacency[j];
+
+					if (!assigned[neighbor] && candidateStamps[neighbor] != stamp)
+					{
+						candidateStamps[neighbor] = stamp;
+						candidates.push_back(neighbor);
+					}
+				}
+			}
+
+			if (clusterTriangles == options.maxTriangles)
+			{
+				break;
+			}
+
+			const glm::vec3 center = centroidSum / static_cast<float>(clusterTriangles);
+			unsigned int best = 0;
+			float bestDistance = std::numeric_limits<float>::max();
+
+			for (unsigned int i = 0; i < candidates.size(); )
+			{
+				const unsigned int candidate = candidates[i];
+
+				if (assigned[candidate])
+				{
+					candidates[i] = candidates.back();
+					candidates.pop_back();
+					continue;
+				}
+
+				unsigned int newVertices = 0;
+
+				for (unsigned int k = 0; k < 3; ++k)
+				{
+					newVertices += vertexStamps[indices[candidate * 3 + k]] != stamp;
+				}
+
+				const glm::vec3 offset = centroids[candidate] - center;
+				const float distance = glm::dot(offset, offset);
+
+				if (clusterVertices + newVertices <= options.maxVertices && distance < bestDistance)
+				{
+					best = i;
+					bestDistance = distance;
+				}
+
+				i++;
+			}
+
+			if (bestDistance == std::numeric_limits<float>::max())
+			{
+				break;
+			}
+
+			next = candidates[best];
+			candidates[best] = candidates.back();
+			candidates.pop_back();
+		}
+
+		clusterEnds.push_back(static_cast<unsigned int>(clusterIndices.size()));
+	}
+}
+
+// Gathers neighboring clusters into groups of up to groupSize, seeding each group with the first cluster left and then taking
+// whichever neighbor shares the most edges with the group so far
+static std::vector<std::vector<unsigned int>> groupClusters(const ClusterHierarchy& hierarchy, const std::vector<unsigned int>& level,
+	const std::vector<unsigned int>& positionIds, const unsigned int groupSize)
+{
+	// Edges of every cluster in the level, keyed by position so clusters on either side of a UV seam still border each other
+	std::unordered_map<uint64_t, unsigned int> edgeOwners;
+	std::unordered_map<uint64_t, unsigned int> sharedEdges; // Keyed by a pair of clusters, by their place in level
+	std::vector<std::vector<unsigned int>> neighbors(level.size());
+
+	for (unsigned int i = 0; i < level.size(); ++i)
+	{
+		const Cluster& cluster = hierarchy.clusters[level[i]];
+
+		for (unsigned int j = cluster.firstIndex; j < cluster.firstIndex + cluster.indexCount; j += 3)
+		{
+			for (unsigned int k = 0; k < 3; ++k)
+			{
+				const uint64_t edge = edgeKey(positionIds[hierarchy.indices[j + k]], positionIds[hierarchy.indices[j + (k + 1) % 3]]);
+				const auto inserted = edgeOwners.emplace(edge, i);
+				const unsigned int owner = inserted.first->second;
+
+				if (!inserted.second && owner != i)
+				{
+					const uint64_t pair = edgeKey(owner, i);
+
+					if (sharedEdges[pair]++ == 0)
+					{
+						neighbors[owner].push_back(i);
+						neighbors[i].push_back(owner);
+					}
+				}
+			}
+		}
+	}
+
+	std::vector<std::vector<unsigned int>> groups;
+	std::vector<unsigned int> groupOf(level.size(), ~0u);
+
+	for (unsigned int seed = 0; seed < level.size(); ++seed)
+	{
+		if (groupOf[seed] != ~0u)
+		{
+			continue;
+		}
+
+		const unsigned int groupIndex = static_cast<unsigned int>(groups.size());
+		std::vector<unsigned int> group{ seed };
+		groupOf[seed] = groupIndex;
+
+		while (group.size() < groupSize)
+		{
+			std::unordered_map<unsigned int, unsigned int> shared;
+			unsigned int best = 0, bestShared = 0;
+
+			for (unsigned int i = 0; i < group.size(); ++i)
+			{
+				for (unsigned int j = 0; j < neighbors[group[i]].size(); ++j)
+				{
+					const unsigned int neighbor = neighbors[group[i]][j];
+
+					if (groupOf[neighbor] == ~0u)
+					{
+						unsigned int& count = shared[neighbor];
+						count += sharedEdges[edgeKey(group[i], neighbor)];
+
+						if (count > bestShared)
+						{
+							best = neighbor;
+							bestShared = count;
+						}
+					}
+				}
+			}
+
+			if (bestShared == 0)
+			{
+				break;
+			}
+
+			group.push_back(best);
+			groupOf[best] = groupIndex;
+		}
+
+		groups.push_back(std::move(group));
+	}
+
+	// Clusters left without any free neighbors would be simplified alone with every edge locked, so they join the neighboring
+	// group they share the most edges with instead
+	for (unsigned int i = 0; i < groups.size(); ++i)
+	{
+		if (groups[i].size() != 1)
+		{
+			continue;
+		}
+
+		const unsigned int cluster = groups[i][0];
+		unsigned int best = ~0u, bestShared = 0;
+
+		for (unsigned int j = 0; j < neighbors[cluster].size(); ++j)
+		{
+			const unsigned int neighbor = neighbors[cluster][j];
+			const unsigned int count = sharedEdges[edgeKey(cluster, neighbor)];
+
+			if (groups[groupOf[neighbor]].size() < groupSize * 2 && groupOf[neighbor] != i && count > bestShared)
+			{
+				best = groupOf[neighbor];
+				bestShared = count;
+			}
+		}
+
+		if (best != ~0u)
+		{
+			groups[best].push_back(cluster);
+			groupOf[cluster] = best;
+			groups[i].clear();
+		}
+	}
+
+	std::vector<std::vector<unsigned int>> result;
+	result.reserve(groups.size());
+
+	for (unsigned int i = 0; i < groups.size(); ++i)
+	{
+		if (groups[i].empty())
+		{
+			continue;
+		}
+
+		for (unsigned int j = 0; j < groups[i].size(); ++j)
+		{
+			groups[i][j] = level[groups[i][j]];
+		}
+
+		result.push_back(std::move(groups[i]));
+	}
+
+	return result;
+}
+
+// Appends the clusters partitioned out of indices to the hierarchy, all measured from the same sphere and error
+static void appendClusters(ClusterHierarchy& hierarchy, const std::vector<Vertex>& vertices, const std::vector<unsigned int>& positionIds,
+	const std::vector<unsigned int>& indices, const ClusterOptions& options, const glm::vec4* lodBounds, const float lodError, std::vector<unsigned int>& level)
+{
+	std::vector<unsigned int> clusterIndices;
+	std::vector<unsigned int> clusterEnds;
+	partitionTriangles(vertices, positionIds, indices, options, clusterIndices, clusterEnds);
+
+	const unsigned int base = static_cast<unsigned int>(hierarchy.indices.size());
+	hierarchy.indices.insert(hierarchy.indices.end(), clusterIndices.begin(), clusterIndices.end());
+
+	for (unsigned int i = 0; i < clusterEnds.size(); ++i)
+	{
+		const unsigned int first = i > 0 ? clusterEnds[i - 1] : 0;
+		const unsigned int count = clusterEnds[i] - first;
+		const glm::vec4 bounds = findBounds(vertices, &clusterIndices[first], count);
+
+		level.push_back(static_cast<unsigned int>(hierarchy.clusters.size()));
+		hierarchy.clusters.push_back(Cluster{ base + first, count, bounds, lodBounds != nullptr ? *lodBounds : bounds, lodError,
+			glm::vec4(0.0f), std::numeric_limits<float>::max() });
+	}
+}
+
+ClusterHierarchy buildClusterHierarchy(const std::vector<Vertex>& vertices, const std::vector<unsigned int>& indices, const ClusterOptions& options)
+{
+	ClusterHierarchy hierarchy;
+	const unsigned int vertexCount = static_cast<unsigned int>(vertices.size());
+
+	// Vertices sharing a position are identified by the first of them
+	std::vector<unsigned int> positionIds(vertexCount);
+	std::unordered_map<glm::vec3, unsigned int, ClusterPositionHash> firstAtPosition;
+
+	for (unsigned int i = 0; i < vertexCount; ++i)
+	{
+		positionIds[i] = firstAtPosition.emplace(vertices[i].position, i).first->second;
+	}
+
+	std::vector<unsigned int> level;
+	appendClusters(hierarchy, vertices, positionIds, indices, options, nullptr, 0.0f, level);
+	hierarchy.levelCount = 1;
+
+	// Groups are simplified on their own vertices, so the simplifier's work scales with the group rather than the mesh
+	std::vector<unsigned int> localIds(vertexCount, ~0u);
+	std::vector<unsigned int> globalIds;
+	std::vector<Vertex> groupVertices;
+	std::vector<unsigned int> groupIndices;
+
+	while (level.size() > 1 && hierarchy.levelCount < options.maxLevels)
+	{
+		const std::vector<std::vector<unsigned int>> groups = groupClusters(hierarchy, level, positionIds, options.groupSize);
+		std::vector<unsigned int> nextLevel;
+
+		for (unsigned int i = 0; i < groups.size(); ++i)
+		{
+			const std::vector<unsigned int>& group = groups[i];
+			groupVertices.clear();
+			groupIndices.clear();
+			globalIds.clear();
+
+			glm::vec4 groupBounds = hierarchy.clusters[group[0]].lodBounds;
+			float childError = 0.0f;
+
+			for (unsigned int j = 0; j < group.size(); ++j)
+			{
+				const Cluster& cluster = hierarchy.clusters[group[j]];
+				groupBounds = mergeBounds(groupBounds, cluster.lodBounds);
+				childError = std::max(childError, cluster.lodError);
+
+				for (unsigned int k = cluster.firstIndex; k < cluster.firstIndex + cluster.indexCount; ++k)
+				{
+					const unsigned int vertex = hierarchy.indices[k];
+
+					if (localIds[vertex] == ~0u)
+					{
+						localIds[vertex] = static_cast<unsigned int>(groupVertices.size());
+						groupVertices.push_back(vertices[vertex]);
+						globalIds.push_back(vertex);
+					}
+
+					groupIndices.push_back(localIds[vertex]);
+				}
+			}
+
+			// Edges between groups are open borders within a group, which the simplifier locks, so neighboring groups still meet
+			const unsigned int targetIndexCount = static_cast<unsigned int>(groupIndices.size() / 6 * 3);
+			SimplifiedLevel simplified = simplifyMesh(groupVertices, groupIndices, targetIndexCount, std::numeric_limits<float>::max());
+
+			for (unsigned int j = 0; j < globalIds.size(); ++j)
+			{
+				localIds[globalIds[j]] = ~0u;
+			}
+
+			// Clusters nothing replaces stay in the cut however far away they are
+			if (simplified.indices.empty() || simplified.indices.size() > groupIndices.size() * (1.0f - options.minReduction))
+			{
+				continue;
+			}
+
+			for (unsigned int j = 0; j < simplified.indices.size(); ++j)
+			{
+				simplified.indices[j] = globalIds[simplified.indices[j]];
+			}
+
+			// Errors add up level by level, so parents are never more accurate than their children
+			const float groupError = childError + simplified.error;
+
+			for (unsigned int j = 0; j < group.size(); ++j)
+			{
+				hierarchy.clusters[group[j]].parentBounds = groupBounds;
+				hierarchy.clusters[group[j]].parentError = groupError;
+			}
+
+			appendClusters(hierarchy, vertices, positionIds, simplified.indices, options, &groupBounds, groupError, nextLevel);
+		}
+
+		if (nextLevel.empty())
+		{
+			break;
+		}
+
+		level.swap(nextLevel);
+		hierarchy.levelCount++;
+	}
+
+	return hierarchy;
+}
+
+ClusterView makeClusterView(const glm::mat4& viewProjection, const glm::vec3& cameraPosition, const float fov, const float nearPlane, const float screenHeight,
+	const float pixelError)
+{
+	ClusterView view;
+
+	// Each plane is the last row of the matrix plus or minus one of the others
+	for (unsigned int i = 0; i < 3; ++i)
+	{
+		for (unsigned int side = 0; side < 2; ++side)
+		{
+			glm::vec4 plane;
+
+			for (unsigned int column = 0; column < 4; ++column)
+			{
+				plane[column] = viewProjection[column][3] + (side == 0 ? viewProjection[column][i] : -viewProjection[column][i]);
+			}
+
+			const float length = std::sqrt(plane.x * plane.x + plane.y * plane.y + plane.z * plane.z);
+			view.frustum[i * 2 + side] = glm::vec4(plane.x / length, plane.y / length, plane.z / length, plane.w / length);
+		}
+	}
+
+	view.cameraPosition = cameraPosition;
+	view.projectionScale = screenHeight * 0.5f / std::tan(fov * 0.5f);
+	view.nearDistance = nearPlane;
+	view.errorThreshold = pixelError;
+
+	return view;
+}
+
+// Error in pixels, as seen from the nearest point of the sphere but no nearer than the near plane, so an error of 0 always projects
+// to 0 and full-detail clusters are drawn even with the camera inside their spheres
+static float projectError(const glm::vec4& bounds, const float error, const glm::mat4& model, const float scale, const ClusterView& view)
+{
+	if (error == std::numeric_limits<float>::max())
+	{
+		return error;
+	}
+
+	const glm::vec3 center = glm::vec3(model * glm::vec4(glm::vec3(bounds), 1.0f));
+	const float distance = std::max(glm::distance(center, view.cameraPosition) - bounds.w * scale, view.nearDistance);
+
+	return error * scale * view.projectionScale / distance;
+}
+
+// Bounds grow with the largest scale along any axis
+static float getBoundsScale(const glm::mat4& model)
+{
+	return std::sqrt(std::max(glm::dot(glm::vec3(model[0]), glm::vec3(model[0])),
+		std::max(glm::dot(glm::vec3(model[1]), glm::vec3(model[1])), glm::dot(glm::vec3(model[2]), glm::vec3(model[2])))));
+}
+
+static bool isInCut(const Cluster& cluster, const glm::mat4& model, const float scale, const ClusterView& view)
+{
+	return projectError(cluster.lodBounds, cluster.lodError, model, scale, view) <= view.errorThreshold &&
+		projectError(cluster.parentBounds, cluster.parentError, model, scale, view) > view.errorThreshold;
+}
+
+unsigned int selectClusters(const std::vector<Cluster>& clusters, const glm::mat4& model, const ClusterView& view, ClusterRun* runs)
+{
+	const float scale = getBoundsScale(model);
+	unsigned int runCount = 0;
+
+	for (unsigned int i = 0; i < clusters.size(); ++i)
+	{
+		const Cluster& cluster = clusters[i];
+
+		if (!isInCut(cluster, model, scale, view))
+		{
+			continue;
+		}
+
+		const glm::vec4 center = model * glm::vec4(glm::vec3(cluster.bounds), 1.0f);
+		const float radius = cluster.bounds.w * scale;
+		bool visible = true;
+
+		for (unsigned int j = 0; j < 6 && visible; ++j)
+		{
+			visible = glm::dot(glm::vec3(view.frustum[j]), glm::vec3(center)) + view.frustum[j].w >= -radius;
+		}
+
+		if (!visible)
+		{
+			continue;
+		}
+
+		if (runCount > 0 && runs[runCount - 1].firstIndex + runs[runCount - 1].indexCount == cluster.firstIndex)
+		{
+			runs[runCount - 1].indexCount += cluster.indexCount;
+		}
+		else
+		{
+			runs[runCount++] = ClusterRun{ cluster.firstIndex, cluster.indexCount };
+		}
+	}
+
+	return runCount;
+}
+
+bool isCutComplete(const std::vector<Cluster>& clusters, const glm::mat4& model, const ClusterView& view)
+{
+	const float scale = getBoundsScale(model);
+	std::vector<bool> covered(clusters.size(), false);
+
+	// Clusters come level by level, so those replacing a cluster, which share its parent's sphere and error, are always decided first
+	for (unsigned int i = static_cast<unsigned int>(clusters.size()); i-- > 0;)
+	{
+		const Cluster& cluster = clusters[i];
+
+		if (isInCut(cluster, model, scale, view))
+		{
+			covered[i] = true;
+			continue;
+		}
+
+		bool replaced = false;
+		bool replacementsCovered = true;
+
+		for (unsigned int j = i + 1; j < clusters.size() && cluster.parentError != std::numeric_limits<float>::max(); ++j)
+		{
+			if (clusters[j].lodError == cluster.parentError && clusters[j].lodBounds == cluster.parentBounds)
+			{
+				replaced = true;
+				replacementsCovered = replacementsCovered && covered[j];
+			}
+		}
+
+		covered[i] = replaced && replacementsCovered;
+	}
+
+	for (unsigned int i = 0; i < clusters.size(); ++i)
+	{
+		if (clusters[i].lodError == 0.0f && !covered[i])
+		{
+			return false;
+		}
+	}
+
+	return true;
+}
@@ -0,0 +1,21 @@
+#include "FrameArena.h"
+
+FrameArena::FrameArena(const size_t capacity)
+	: buffer(new unsigned char[capacity]), capacity(capacity)
+{
+}
+
+FrameArena::~FrameArena()
+{
+	delete[] buffer;
+}
+
+void FrameArena::reset()
+{
+	used = 0;
+}
+
+size_t FrameArena::getHighWater() const
+{
+	return highWater;
+}
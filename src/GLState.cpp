@@ -0,0 +1,151 @@
+#include "GLState.h"
+
+const int unknownUniform = -2147483647 - 1; // Uniforms hold whatever the program was linked with until the cache sets them
+
+GLStateCache glState;
+
+static unsigned int getTargetIndex(const GLenum target)
+{
+	return target == GL_TEXTURE_2D ? 0 : 1;
+}
+
+GLStateCache::GLStateCache()
+{
+	for (unsigned int i = 0; i < cachedTextureUnits; ++i)
+	{
+		for (unsigned int j = 0; j < cachedTextureTargets; ++j)
+		{
+			textures[i][j] = 0;
+		}
+	}
+}
+
+void GLStateCache::useProgram(const unsigned int program)
+{
+	if (this->program == program)
+	{
+		counters.skipped++;
+		return;
+	}
+
+	glUseProgram(program);
+	this->program = program;
+	programUniforms = &uniforms[program];
+	counters.issued++;
+}
+
+void GLStateCache::bindVertexArray(const unsigned int vertexArray)
+{
+	if (this->vertexArray == vertexArray)
+	{
+		counters.skipped++;
+		return;
+	}
+
+	glBindVertexArray(vertexArray);
+	this->vertexArray = vertexArray;
+	counters.issued++;
+}
+
+void GLStateCache::bindTexture(const unsigned int unit, const GLenum target, const unsigned int texture)
+{
+	unsigned int* bound = unit < cachedTextureUnits ? &textures[unit][getTargetIndex(target)] : nullptr;
+
+	if (bound != nullptr && *bound == texture)
+	{
+		counters.skipped++;
+		return;
+	}
+
+	if (activeUnit != unit)
+	{
+		glActiveTexture(GL_TEXTURE0 + unit);
+		activeUnit = unit;
+		counters.issued++;
+	}
+
+	glBindTexture(target, texture);
+	counters.issued++;
+
+	if (bound != nullptr)
+	{
+		*bound = texture;
+	}
+}
+
+void GLStateCache::setUniform(const int location, const int value)
+{
+	// OpenGL silently ignores location -1, for uniforms the program doesn't use
+	if (location < 0)
+	{
+		counters.skipped++;
+		return;
+	}
+
+	if (programUniforms == nullptr)
+	{
+		glUniform1i(location, value);
+		counters.issued++;
+		return;
+	}
+
+	if (programUniforms->size() <= static_cast<unsigned int>(location))
+	{
+		programUniforms->resize(location + 1, unknownUniform);
+	}
+
+	int& current = (*programUniforms)[location];
+
+	if (current == value)
+	{
+		counters.skipped++;
+		return;
+	}
+
+	glUniform1i(location, value);
+	current = value;
+	counters.issued++;
+}
+
+void GLStateCache::forgetVertexArray(const unsigned int vertexArray)
+{
+	if (this->vertexArray == vertexArray)
+	{
+		this->vertexArray = 0;
+	}
+}
+
+void GLStateCache::forgetTexture(const unsigned int texture)
+{
+	for (unsigned int i = 0; i < cachedTextureUnits; ++i)
+	{
+		for (unsigned int j = 0; j < cachedTextureTargets; ++j)
+		{
+			if (textures[i][j] == texture)
+			{
+				textures[i][j] = 0;
+			}
+		}
+	}
+}
+
+void GLStateCache::forgetProgram(const unsigned int program)
+{
+	if (this->program == program)
+	{
+		this->program = 0;
+		programUniforms = nullptr;
+	}
+
+	uniforms.erase(program);
+}
+
+void GLStateCache::resetCounters()
+{
+	counters = GLStateCounters{};
+}
+
+const GLStateCounters& GLStateCache::getCounters() const
+{
+	return counters;
+}
@@ -0,0 +1,326 @@
+#include <glad/glad.h>
+
+#include <algorithm>
+#include <cstddef>
+
+#include "GeometryPool.h"
+#include "GLState.h"
+
+RangeAllocator::RangeAllocator(const unsigned int capacity)
+	: capacity(capacity)
+{
+	if (capacity > 0)
+	{
+		freeBlocks.push_back(Block{ 0, capacity });
+	}
+}
+
+bool RangeAllocator::allocate(const unsigned int size, unsigned int& offset, const unsigned int alignment)
+{
+	for (unsigned int i = 0; i < freeBlocks.size(); ++i)
+	{
+		Block& block = freeBlocks[i];
+		const unsigned int padding = (alignment - block.offset % alignment) % alignment;
+
+		if (block.size >= size + padding)
+		{
+			offset = block.offset + padding;
+			block.offset += padding + size;
+			block.size -= padding + size;
+
+			// Padding skipped for alignment stays free in front of the allocation
+			if (block.size == 0)
+			{
+				freeBlocks.erase(freeBlocks.begin() + i);
+			}
+
+			if (padding > 0)
+			{
+				free(offset - padding, padding);
+			}
+
+			return true;
+		}
+	}
+
+	return false;
+}
+
+void RangeAllocator::free(const unsigned int offset, const unsigned int size)
+{
+	if (size == 0)
+	{
+		return;
+	}
+
+	auto next = std::lower_bound(freeBlocks.begin(), freeBlocks.end(), offset, [](const Block& block, const unsigned int offset) { return block.offset < offset; });
+	auto current = freeBlocks.insert(next, Block{ offset, size });
+
+	// Merge with the following block, then the preceding one
+	if (current + 1 != freeBlocks.end() && current->offset + current->size == (current + 1)->offset)
+	{
+		current->size += (current + 1)->size;
+		current = freeBlocks.erase(current + 1) - 1;
+	}
+
+	if (current != freeBlocks.begin() && (current - 1)->offset + (current - 1)->size == current->offset)
+	{
+		(current - 1)->size += current->size;
+		freeBlocks.erase(current);
+	}
+}
+
+void RangeAllocator::grow(const unsigned int capacity)
+{
+	free(this->capacity, capacity - this->capacity);
+	this->capacity = capacity;
+}
+
+unsigned int RangeAllocator::getCapacity() const
+{
+	return capacity;
+}
+
+GeometryPool::GeometryPool(const unsigned int vertexCapacity, const unsigned int indexCapacity)
+	: initialVertexCapacity(vertexCapacity), indexRanges(indexCapacity)
+{
+	glGenBuffers(1, &elementBuffer);
+	glBindBuffer(GL_COPY_WRITE_BUFFER, elementBuffer);
+	glBufferData(GL_COPY_WRITE_BUFFER, indexCapacity * sizeof(unsigned short), nullptr, GL_STATIC_DRAW);
+}
+
+GeometryPool::~GeometryPool()
+{
+	for (unsigned int i = 0; i < vertexFormatCount; ++i)
+	{
+		if (vertexStores[i].vertexArray != 0)
+		{
+			glState.forgetVertexArray(vertexStores[i].vertexArray);
+			glDeleteVertexArrays(1, &vertexStores[i].vertexArray);
+			glDeleteBuffers(1, &vertexStores[i].vertexBuffer);
+		}
+	}
+
+	glDeleteBuffers(1, &elementBuffer);
+}
+
+GeometryRange GeometryPool::allocate(const VertexFormat format, const std::vector<unsigned char>& vertexData, const unsigned int vertexCount, const std::vector<unsigned int>& indices)
+{
+	VertexStore& store = vertexStores[static_cast<unsigned int>(format)];
+	const unsigned int stride = getVertexStride(format);
+	GeometryRange range;
+	range.format = format;
+	range.vertexCount = vertexCount;
+	range.indexCount = static_cast<unsigned int>(indices.size());
+	range.indexSize = vertexCount <= 65536 ? sizeof(unsigned short) : sizeof(unsigned int);
+
+	const unsigned int indexSlots = range.indexCount * range.indexSize / sizeof(unsigned short);
+	const unsigned int indexAlignment = range.indexSize / sizeof(unsigned short);
+	unsigned int indexSlot;
+
+	if (store.vertexArray == 0)
+	{
+		createVertexArray(format);
+	}
+
+	if (!store.ranges.allocate(range.vertexCount, range.baseVertex))
+	{
+		growVertices(format, range.vertexCount);
+		store.ranges.allocate(range.vertexCount, range.baseVertex);
+	}
+
+	if (!indexRanges.allocate(indexSlots, indexSlot, indexAlignment))
+	{
+		growIndices(indexSlots + indexAlignment);
+		indexRanges.allocate(indexSlots, indexSlot, indexAlignment);
+	}
+
+	range.firstIndex = indexSlot / indexAlignment;
+
+	// The element buffer binding belongs to the vertex array, so bind one of the pool's before touching it
+	glState.bindVertexArray(store.vertexArray);
+	glBindBuffer(GL_ARRAY_BUFFER, store.vertexBuffer);
+	glBufferSubData(GL_ARRAY_BUFFER, range.baseVertex * stride, range.vertexCount * stride, vertexData.data());
+
+	if (range.indexSize == sizeof(unsigned short))
+	{
+		// Indices are relative to baseVertex, so any mesh with up to 65536 vertices fits in 16 bits
+		const std::vector<unsigned short> shortIndices(indices.begin(), indices.end());
+		glBufferSubData(GL_ELEMENT_ARRAY_BUFFER, range.firstIndex * sizeof(unsigned short), range.indexCount * sizeof(unsigned short), shortIndices.data());
+	}
+	else
+	{
+		glBufferSubData(GL_ELEMENT_ARRAY_BUFFER, range.firstIndex * sizeof(unsigned int), range.indexCount * sizeof(unsigned int), indices.data());
+	}
+
+	glState.bindVertexArray(0);
+
+	return range;
+}
+
+void GeometryPool::free(const GeometryRange& range)
+{
+	vertexStores[static_cast<unsigned int>(range.format)].ranges.free(range.baseVertex, range.vertexCount);
+	const unsigned int slotsPerIndex = range.indexSize / sizeof(unsigned short);
+	indexRanges.free(range.firstIndex * slotsPerIndex, range.indexCount * slotsPerIndex);
+}
+
+unsigned int GeometryPool::getVertexArray(const VertexFormat format) const
+{
+	return vertexStores[static_cast<unsigned int>(format)].vertexArray;
+}
+
+void GeometryPool::setInstanceBuffer(const unsigned int buffer)
+{
+	instanceBuffer = buffer;
+
+	for (unsigned int i = 0; i < vertexFormatCount; ++i)
+	{
+		if (vertexStores[i].vertexArray != 0)
+		{
+			glState.bindVertexArray(vertexStores[i].vertexArray);
+			setInstanceAttributes(0);
+			vertexStores[i].instanceOffset = 0;
+		}
+	}
+
+	glState.bindVertexArray(0);
+}
+
+void GeometryPool::bindVertexArray(const VertexFormat format, const size_t instanceOffset)
+{
+	VertexStore& store = vertexStores[static_cast<unsigned int>(format)];
+	glState.bindVertexArray(store.vertexArray);
+
+	// Only re-point the instance attributes when a draw starts somewhere else in the instance buffer
+	if (store.instanceOffset != instanceOffset)
+	{
+		setInstanceAttributes(instanceOffset);
+		store.instanceOffset = instanceOffset;
+	}
+}
+
+void GeometryPool::createVertexArray(const VertexFormat format)
+{
+	VertexStore& store = vertexStores[static_cast<unsigned int>(format)];
+	glGenVertexArrays(1, &store.vertexArray);
+	glState.bindVertexArray(store.vertexArray);
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, elementBuffer);
+
+	if (instanceBuffer != 0)
+	{
+		setInstanceAttributes(0);
+	}
+
+	glState.bindVertexArray(0);
+}
+
+// Copies everything into a buffer at least twice the size, then points the vertex array at the new one
+void GeometryPool::growVertices(const VertexFormat format, const unsigned int vertexCount)
+{
+	VertexStore& store = vertexStores[static_cast<unsigned int>(format)];
+	const unsigned int stride = getVertexStride(format);
+	const unsigned int oldCapacity = store.ranges.getCapacity();
+	const unsigned int capacity = std::max(std::max(oldCapacity * 2, oldCapacity + vertexCount), initialVertexCapacity);
+	unsigned int buffer;
+
+	glGenBuffers(1, &buffer);
+	glBindBuffer(GL_COPY_WRITE_BUFFER, buffer);
+	glBufferData(GL_COPY_WRITE_BUFFER, capacity * stride, nullptr, GL_STATIC_DRAW);
+
+	if (store.vertexBuffer != 0)
+	{
+		glBindBuffer(GL_COPY_READ_BUFFER, store.vertexBuffer);
+		glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, 0, oldCapacity * stride);
+		glDeleteBuffers(1, &store.vertexBuffer);
+	}
+
+	store.vertexBuffer = buffer;
+
+	glState.bindVertexArray(store.vertexArray);
+	glBindBuffer(GL_ARRAY_BUFFER, store.vertexBuffer);
+	setVertexAttributes(format);
+	glState.bindVertexArray(0);
+
+	store.ranges.grow(capacity);
+}
+
+void GeometryPool::growIndices(const unsigned int slotCount)
+{
+	const unsigned int oldCapacity = indexRanges.getCapacity();
+	const unsigned int capacity = std::max(oldCapacity * 2, oldCapacity + slotCount);
+	unsigned int buffer;
+
+	glGenBuffers(1, &buffer);
+	glBindBuffer(GL_COPY_WRITE_BUFFER, buffer);
+	glBufferData(GL_COPY_WRITE_BUFFER, capacity * sizeof(unsigned short), nullptr, GL_STATIC_DRAW);
+	glBindBuffer(GL_COPY_READ_BUFFER, elementBuffer);
+	glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, 0, oldCapacity * sizeof(unsigned short));
+	glDeleteBuffers(1, &elementBuffer);
+	elementBuffer = buffer;
+
+	// Every vertex array shares the one element buffer
+	for (unsigned int i = 0; i < vertexFormatCount; ++i)
+	{
+		if (vertexStores[i].vertexArray != 0)
+		{
+			glState.bindVertexArray(vertexStores[i].vertexArray);
+			glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, elementBuffer);
+		}
+	}
+
+	glState.bindVertexArray(0);
+	indexRanges.grow(capacity);
+}
+
+// Expects the vertex array and vertex buffer to be bound; compact formats are normalized by OpenGL and decoded the rest of the way in shader.vs
+void GeometryPool::setVertexAttributes(const VertexFormat format) const
+{
+	const size_t size = getVertexStride(format);
+	glEnableVertexAttribArray(0);
+	glEnableVertexAttribArray(1);
+	glEnableVertexAttribArray(2);
+
+	switch (format)
+	{
+		case VertexFormat::Full:
+			glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, size, (void*)0); // vertex positions
+			glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, size, (void*)offsetof(Vertex, normal)); // vertex normals
+			glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, size, (void*)offsetof(Vertex, texCoords)); // vertex texture coords
+			break;
+		case VertexFormat::Octahedral:
+			glVertexAttribPointer(0, 3, GL_UNSIGNED_SHORT, GL_TRUE, size, (void*)offsetof(CompactVertex, position));
+			glVertexAttribPointer(1, 2, GL_SHORT, GL_TRUE, size, (void*)offsetof(CompactVertex, normal));
+			glVertexAttribPointer(2, 2, GL_HALF_FLOAT, GL_FALSE, size, (void*)offsetof(CompactVertex, texCoords));
+			break;
+		case VertexFormat::Packed:
+			glVertexAttribPointer(0, 3, GL_UNSIGNED_SHORT, GL_TRUE, size, (void*)offsetof(CompactVertex, position));
+			glVertexAttribPointer(1, 4, GL_INT_2_10_10_10_REV, GL_TRUE, size, (void*)offsetof(CompactVertex, normal));
+			glVertexAttribPointer(2, 2, GL_HALF_FLOAT, GL_FALSE, size, (void*)offsetof(CompactVertex, texCoords));
+			break;
+	}
+}
+
+// Expects the vertex array to be bound; each column of the matrix is its own attribute, and everything advances once per instance
+void GeometryPool::setInstanceAttributes(const size_t instanceOffset) const
+{
+	glBindBuffer(GL_ARRAY_BUFFER, instanceBuffer);
+
+	for (unsigned int i = 0; i < 4; ++i)
+	{
+		const unsigned int location = instanceMatrixLocation + i;
+		glEnableVertexAttribArray(location);
+		glVertexAttribPointer(location, 4, GL_FLOAT, GL_FALSE, sizeof(InstanceData), (void*)(instanceOffset + offsetof(InstanceData, model) + sizeof(glm::vec4) * i));
+		glVertexAttribDivisor(location, 1);
+	}
+
+	glEnableVertexAttribArray(instanceQuantizationLocation);
+	glVertexAttribPointer(instanceQuantizationLocation, 4, GL_FLOAT, GL_FALSE, sizeof(InstanceData), (void*)(instanceOffset + offsetof(InstanceData, positionOffset)));
+	glVertexAttribDivisor(instanceQuantizationLocation, 1);
+	glEnableVertexAttribArray(instanceQuantizationLocation + 1);
+	glVertexAttribPointer(instanceQuantizationLocation + 1, 4, GL_FLOAT, GL_FALSE, sizeof(InstanceData), (void*)(instanceOffset + offsetof(InstanceData, positionScale)));
+	glVertexAttribDivisor(instanceQuantizationLocation + 1, 1);
+	glEnableVertexAttribArray(instanceFadeLocation);
+	glVertexAttribPointer(instanceFadeLocation, 1, GL_FLOAT, GL_FALSE, sizeof(InstanceData), (void*)(instanceOffset + offsetof(InstanceData, fade)));
+	glVertexAttribDivisor(instanceFadeLocation, 1);
+}
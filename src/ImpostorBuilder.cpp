@@ -0,0 +1,173 @@
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include <cmath>
+#include <limits>
+#include <iostream>
+#include <algorithm>
+
+#include "ImpostorBuilder.h"
+#include "InstanceBatcher.h"
+#include "FrameArena.h"
+#include "GLState.h"
+
+const size_t impostorArenaSize = 1 << 16;
+const unsigned int minimumMipSize = 8; // Smallest a view may get in the atlas's mipmaps before neighboring views bleed into it
+
+// Folds the lower hemisphere over the upper one, with y as the pole
+glm::vec2 encodeViewDirection(const glm::vec3& direction)
+{
+	const glm::vec3 d = direction / (std::fabs(direction.x) + std::fabs(direction.y) + std::fabs(direction.z));
+	glm::vec2 p(d.x, d.z);
+
+	if (d.y < 0.0f)
+	{
+		p = glm::vec2((1.0f - std::fabs(p.y)) * (p.x >= 0.0f ? 1.0f : -1.0f), (1.0f - std::fabs(p.x)) * (p.y >= 0.0f ? 1.0f : -1.0f));
+	}
+
+	return p * 0.5f + glm::vec2(0.5f);
+}
+
+glm::vec3 decodeViewDirection(const glm::vec2& coordinates)
+{
+	glm::vec2 p = coordinates * 2.0f - glm::vec2(1.0f);
+	const float y = 1.0f - std::fabs(p.x) - std::fabs(p.y);
+
+	if (y < 0.0f)
+	{
+		p = glm::vec2((1.0f - std::fabs(p.y)) * (p.x >= 0.0f ? 1.0f : -1.0f), (1.0f - std::fabs(p.x)) * (p.y >= 0.0f ? 1.0f : -1.0f));
+	}
+
+	return glm::normalize(glm::vec3(p.x, y, p.y));
+}
+
+Model buildImpostor(const std::vector<LODChain>& chains, const unsigned int chain, GeometryPool& pool, const unsigned int shader, const ImpostorOptions& options)
+{
+	// Views are framed around a sphere enclosing every mesh, so the model fits whichever way it's seen from
+	const std::vector<Mesh>& meshes = chains[chain].getLevel(0).getMeshes();
+	glm::vec3 minimum(std::numeric_limits<float>::max()), maximum(-std::numeric_limits<float>::max());
+
+	for (unsigned int i = 0; i < meshes.size(); ++i)
+	{
+		const VertexQuantization& bounds = meshes[i].getBounds();
+		minimum = glm::min(minimum, bounds.offset);
+		maximum = glm::max(maximum, bounds.offset + bounds.scale);
+	}
+
+	const glm::vec3 center = (minimum + maximum) * 0.5f;
+	const float radius = glm::length(maximum - minimum) * 0.5f;
+	const unsigned int atlasSize = options.frames * options.frameSize;
+
+	unsigned int atlas;
+	glGenTextures(1, &atlas);
+	glState.bindTexture(0, GL_TEXTURE_2D, atlas);
+	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, atlasSize, atlasSize, 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+
+	unsigned int depth;
+	glGenRenderbuffers(1, &depth);
+	glBindRenderbuffer(GL_RENDERBUFFER, depth);
+	glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, atlasSize, atlasSize);
+
+	unsigned int framebuffer;
+	glGenFramebuffers(1, &framebuffer);
+	glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, atlas, 0);
+	glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, depth);
+
+	if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+	{
+		std::cout << "Impostor framebuffer is incomplete" << std::endl;
+	}
+
+	GLint viewport[4];
+	glGetIntegerv(GL_VIEWPORT, viewport);
+	glClearColor(0.0f, 0.0f, 0.0f, 0.0f);
+	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+	unsigned int cameraBuffer;
+	glGenBuffers(1, &cameraBuffer);
+	glBindBuffer(GL_UNIFORM_BUFFER, cameraBuffer);
+	glBufferData(GL_UNIFORM_BUFFER, sizeof(CameraBlock), nullptr, GL_DYNAMIC_DRAW);
+	glBindBufferBase(GL_UNIFORM_BUFFER, cameraBlockBinding, cameraBuffer);
+	glUniformBlockBinding(shader, glGetUniformBlockIndex(shader, "Camera"), cameraBlockBinding);
+	glState.useProgram(shader);
+
+	// Each view is an orthographic projection of the sphere from the direction at the center of its frame
+	InstanceBatcher* batcher = new InstanceBatcher(chains, pool, shader);
+	FrameArena arena(impostorArenaSize);
+	const glm::mat4 identity(1.0f);
+	const unsigned int level = 0;
+
+	for (unsigned int y = 0; y < options.frames; ++y)
+	{
+		for (unsigned int x = 0; x < options.frames; ++x)
+		{
+			const glm::vec3 direction = decodeViewDirection((glm::vec2(x, y) + glm::vec2(0.5f)) / static_cast<float>(options.frames));
+			const glm::vec3 up = std::fabs(direction.y) > 0.999f ? glm::vec3(0.0f, 0.0f, 1.0f) : glm::vec3(0.0f, 1.0f, 0.0f); // Matches shader.vs
+			const glm::vec3 eye = center + direction * (radius * 2.0f);
+
+			CameraBlock camera;
+			camera.view = glm::lookAt(eye, center, up);
+			camera.projection = glm::ortho(-radius, radius, -radius, radius, radius * 0.5f, radius * 3.5f);
+			camera.position = glm::vec4(eye, 1.0f);
+			glBindBuffer(GL_UNIFORM_BUFFER, cameraBuffer);
+			glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(CameraBlock), &camera);
+
+			glViewport(x * options.frameSize, y * options.frameSize, options.frameSize, options.frameSize);
+			arena.reset();
+			DrawGroup* groups = nullptr;
+			const unsigned int groupCount = batcher->batch(&chain, &level, &identity, nullptr, 1, eye, radius * 3.5f, arena, groups);
+			batcher->draw(groups, groupCount);
+		}
+	}
+
+	delete batcher;
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+	glDeleteFramebuffers(1, &framebuffer);
+	glDeleteRenderbuffers(1, &depth);
+	glDeleteBuffers(1, &cameraBuffer);
+	glViewport(viewport[0], viewport[1], viewport[2], viewport[3]);
+
+	unsigned int maxLevel = 0;
+
+	while ((options.frameSize >> (maxLevel + 1)) >= minimumMipSize)
+	{
+		maxLevel++;
+	}
+
+	glState.bindTexture(0, GL_TEXTURE_2D, atlas);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, static_cast<GLint>(maxLevel));
+	glGenerateMipmap(GL_TEXTURE_2D);
+
+	// The quad's corners come from its texture coordinates; positions only give it bounds
+	std::vector<Vertex> vertices(4);
+
+	for (unsigned int i = 0; i < 4; ++i)
+	{
+		const glm::vec2 corner(static_cast<float>(i & 1), static_cast<float>(i >> 1));
+		vertices[i].position = center + glm::vec3(corner.x * 2.0f - 1.0f, corner.y * 2.0f - 1.0f, 0.0f) * radius;
+		vertices[i].normal = glm::vec3(0.0f, 0.0f, 1.0f);
+		vertices[i].texCoords = corner;
+	}
+
+	Impostor impostor;
+	impostor.atlas = atlas;
+	impostor.frames = options.frames;
+	impostor.bounds = glm::vec4(center, radius);
+
+	std::vector<Mesh> quad;
+	quad.emplace_back(pool, std::move(vertices), std::vector<unsigned int>{ 0, 1, 2, 1, 3, 2 }, std::vector<Texture>{}, VertexFormat::Full);
+	quad.back().setImpostor(impostor);
+
+	std::cout << "Rendered impostor of " << options.frames * options.frames << " views into a " << atlasSize << "x" << atlasSize << " atlas" << std::endl;
+
+	// Views are furthest off from the camera's direction halfway between frames
+	const float viewError = radius * std::sin(glm::radians(90.0f) / options.frames);
+
+	return Model(std::move(quad), shader, viewError);
+}
@@ -0,0 +1,364 @@
+#include <glad/glad.h>
+#include <GLFW/glfw3.h>
+
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+
+#include "InstanceBatcher.h"
+#include "GLState.h"
+
+const GLenum drawIndirectBuffer = 0x8F3F; // GL_DRAW_INDIRECT_BUFFER, which OpenGL 3.3 headers don't define
+const unsigned int initialStreamInstances = 1024; // Streams grow past these when a frame needs more
+const unsigned int initialStreamCommands = 256;
+
+InstanceBatcher::InstanceBatcher(const std::vector<LODChain>& chains, GeometryPool& pool, const unsigned int shader, const bool allowIndirect)
+	: pool(&pool), program(shader), normalEncodingLocation(glGetUniformLocation(shader, "normalEncoding")),
+	impostorFramesLocation(glGetUniformLocation(shader, "impostorFrames")), impostorBoundsLocation(glGetUniformLocation(shader, "impostorBounds")),
+	instanceStream(GL_ARRAY_BUFFER, initialStreamInstances * sizeof(InstanceData), sizeof(InstanceData))
+{
+	setChains(chains);
+
+	GLint major = 0, minor = 0;
+	glGetIntegerv(GL_MAJOR_VERSION, &major);
+	glGetIntegerv(GL_MINOR_VERSION, &minor);
+
+	if (allowIndirect && (major > 4 || (major == 4 && minor >= 3)))
+	{
+		multiDrawElementsIndirect = (MultiDrawElementsIndirect)glfwGetProcAddress("glMultiDrawElementsIndirect");
+	}
+
+	// The draw indirect target doesn't exist before OpenGL 4.0, so commands only get a buffer when they'll be read from one
+	if (multiDrawElementsIndirect != nullptr)
+	{
+		commandStream = new StreamBuffer(drawIndirectBuffer, initialStreamCommands * sizeof(DrawElementsIndirectCommand), sizeof(DrawElementsIndirectCommand));
+	}
+
+	std::cout << (multiDrawElementsIndirect != nullptr ? "Drawing with glMultiDrawElementsIndirect" : "Drawing with one call per indirect command") << std::endl;
+
+	attachedInstanceBuffer = instanceStream.getBuffer();
+	pool.setInstanceBuffer(attachedInstanceBuffer);
+
+	// Until a view is given, clustered meshes draw their full-detail clusters without culling
+	for (unsigned int i = 0; i < 6; ++i)
+	{
+		clusterView.frustum[i] = glm::vec4(0.0f, 0.0f, 0.0f, 1.0f);
+	}
+
+	clusterView.cameraPosition = glm::vec3(0.0f);
+	clusterView.projectionScale = 1.0f;
+	clusterView.nearDistance = 1.0f;
+	clusterView.errorThreshold = 0.0f;
+}
+
+InstanceBatcher::~InstanceBatcher()
+{
+	delete commandStream;
+}
+
+unsigned int InstanceBatcher::batch(const unsigned int* modelChains, const unsigned int* modelLODs, const glm::mat4* modelMatrices, const float* modelFades,
+	const unsigned int modelCount, const glm::vec3& cameraPosition, const float farPlane, FrameArena& arena, DrawGroup*& groups)
+{
+	unsigned int* bucketStarts = arena.allocate<unsigned int>(bucketCount + 1);
+	glm::mat4* sortedMatrices = arena.allocate<glm::mat4>(modelCount);
+	float* sortedFades = arena.allocate<float>(modelCount);
+
+	if (bucketStarts == nullptr || sortedMatrices == nullptr || sortedFades == nullptr)
+	{
+		return 0;
+	}
+
+	std::fill(bucketStarts, bucketStarts + bucketCount + 1, 0);
+
+	for (unsigned int i = 0; i < modelCount; ++i)
+	{
+		bucketStarts[bucketOffsets[modelChains[i]] + modelLODs[i] + 1]++;
+	}
+
+	// Every mesh of a level in view gets a command, and its own copy of the level's instances for its quantization; clustered meshes
+	// are counted once their cuts are chosen
+	unsigned int commandCount = 0;
+	unsigned int instanceCount = 0;
+	unsigned int clusteredCount = 0;
+
+	for (unsigned int i = 0; i < bucketCount; ++i)
+	{
+		const unsigned int count = bucketStarts[i + 1];
+
+		for (unsigned int j = bucketMeshes[i]; count > 0 && j < bucketMeshes[i + 1]; ++j)
+		{
+			if (meshDraws[j].clustered)
+			{
+				clusteredCount += count;
+				continue;
+			}
+
+			commandCount++;
+			instanceCount += count;
+		}
+
+		bucketStarts[i + 1] += bucketStarts[i];
+	}
+
+	for (unsigned int i = 0; i < modelCount; ++i)
+	{
+		const unsigned int slot = bucketStarts[bucketOffsets[modelChains[i]] + modelLODs[i]]++;
+		sortedMatrices[slot] = modelMatrices[i];
+		sortedFades[slot] = modelFades != nullptr ? modelFades[i] : opaqueFade;
+	}
+
+	// Each instance of a clustered mesh gets its own instance and a command for every run of clusters in its cut
+	ClusterRun** cuts = arena.allocate<ClusterRun*>(clusteredCount);
+	unsigned int* cutSizes = arena.allocate<unsigned int>(clusteredCount);
+	ClusterRun* selected = arena.allocate<ClusterRun>(maxClusterCount);
+
+	if (cuts == nullptr || cutSizes == nullptr || selected == nullptr)
+	{
+		return 0;
+	}
+
+	unsigned int cutIndex = 0;
+
+	for (unsigned int bucket = 0; bucket < bucketCount; ++bucket)
+	{
+		const unsigned int first = bucket > 0 ? bucketStarts[bucket - 1] : 0;
+		const unsigned int count = bucketStarts[bucket] - first;
+
+		for (unsigned int i = bucketMeshes[bucket]; count > 0 && i < bucketMeshes[bucket + 1]; ++i)
+		{
+			for (unsigned int j = 0; meshDraws[i].clustered && j < count; ++j)
+			{
+				const unsigned int runCount = selectClusters(meshDraws[i].mesh->getClusters(), sortedMatrices[first + j], clusterView, selected);
+				cuts[cutIndex] = arena.allocate<ClusterRun>(runCount);
+
+				if (cuts[cutIndex] == nullptr)
+				{
+					return 0;
+				}
+
+				std::copy(selected, selected + runCount, cuts[cutIndex]);
+				cutSizes[cutIndex++] = runCount;
+				commandCount += runCount;
+				instanceCount++;
+			}
+		}
+	}
+
+	DrawElementsIndirectCommand* unsortedCommands = arena.allocate<DrawElementsIndirectCommand>(commandCount);
+	DrawElementsIndirectCommand* frameCommands = arena.allocate<DrawElementsIndirectCommand>(commandCount);
+	const Mesh** commandMeshes = arena.allocate<const Mesh*>(commandCount);
+	groups = arena.allocate<DrawGroup>(commandCount);
+
+	if (unsortedCommands == nullptr || frameCommands == nullptr || commandMeshes == nullptr || groups == nullptr || !queue.begin(arena, commandCount))
+	{
+		return 0;
+	}
+
+	// Instances are written straight into this frame's region, and commands address them from the start of the buffer
+	InstanceData* instances = (InstanceData*)instanceStream.map(instanceCount * sizeof(InstanceData));
+	const unsigned int baseInstance = static_cast<unsigned int>(instanceStream.getOffset() / sizeof(InstanceData));
+
+	if (instanceStream.getBuffer() != attachedInstanceBuffer)
+	{
+		attachedInstanceBuffer = instanceStream.getBuffer();
+		pool->setInstanceBuffer(attachedInstanceBuffer);
+	}
+
+	// Buckets are in chain and level order, and bucketStarts now holds each bucket's end
+	unsigned int commandIndex = 0;
+	unsigned int instanceIndex = 0;
+	cutIndex = 0;
+
+	for (unsigned int bucket = 0; bucket < bucketCount; ++bucket)
+	{
+		const unsigned int first = bucket > 0 ? bucketStarts[bucket - 1] : 0;
+		const unsigned int count = bucketStarts[bucket] - first;
+		float nearest = farPlane;
+
+		for (unsigned int j = 0; j < count; ++j)
+		{
+			nearest = std::min(nearest, glm::distance(glm::vec3(sortedMatrices[first + j][3]), cameraPosition));
+		}
+
+		for (unsigned int i = bucketMeshes[bucket]; count > 0 && i < bucketMeshes[bucket + 1]; ++i)
+		{
+			const Mesh& mesh = *meshDraws[i].mesh;
+			const GeometryRange& range = mesh.getRange();
+			const VertexQuantization& quantization = mesh.getQuantization();
+			const glm::vec2 layers = mesh.getTextureLayers();
+			const unsigned int vertexArray = static_cast<unsigned int>(range.format) << 1 | (range.indexSize == sizeof(unsigned short) ? 0 : 1);
+
+			if (meshDraws[i].clustered)
+			{
+				for (unsigned int j = 0; j < count; ++j)
+				{
+					const ClusterRun* runs = cuts[cutIndex];
+					const unsigned int runCount = cutSizes[cutIndex++];
+					const float depth = glm::distance(glm::vec3(sortedMatrices[first + j][3]), cameraPosition) / farPlane;
+					instances[instanceIndex] = InstanceData{ sortedMatrices[first + j], glm::vec4(quantization.offset, layers.x), glm::vec4(quantization.scale, layers.y), sortedFades[first + j] };
+
+					for (unsigned int k = 0; k < runCount; ++k)
+					{
+						unsortedCommands[commandIndex] = DrawElementsIndirectCommand{ runs[k].indexCount, 1, range.firstIndex + runs[k].firstIndex, static_cast<int>(range.baseVertex),
+							baseInstance + instanceIndex };
+						commandMeshes[commandIndex] = &mesh;
+						queue.push(makeSortKey(program, meshDraws[i].material, vertexArray, depth), commandIndex);
+						commandIndex++;
+					}
+
+					instanceIndex++;
+				}
+
+				continue;
+			}
+
+			unsortedCommands[commandIndex] = DrawElementsIndirectCommand{ range.indexCount, count, range.firstIndex, static_cast<int>(range.baseVertex), baseInstance + instanceIndex };
+			commandMeshes[commandIndex] = &mesh;
+
+			for (unsigned int j = 0; j < count; ++j)
+			{
+				instances[instanceIndex++] = InstanceData{ sortedMatrices[first + j], glm::vec4(quantization.offset, layers.x), glm::vec4(quantization.scale, layers.y), sortedFades[first + j] };
+			}
+
+			queue.push(makeSortKey(program, meshDraws[i].material, vertexArray, nearest / farPlane), commandIndex);
+			commandIndex++;
+		}
+	}
+
+	instanceStream.unmap();
+
+	// Commands are laid out in key order, and each run sharing draw state becomes one group
+	queue.sort();
+	const uint64_t* keys = queue.getKeys();
+	const unsigned int* order = queue.getItems();
+	unsigned int groupCount = 0;
+
+	for (unsigned int i = 0; i < commandCount; ++i)
+	{
+		frameCommands[i] = unsortedCommands[order[i]];
+
+		if (i > 0 && sharesDrawState(keys[i - 1], keys[i]))
+		{
+			groups[groupCount - 1].commandCount++;
+		}
+		else
+		{
+			groups[groupCount++] = DrawGroup{ commandMeshes[order[i]], i, 1 };
+		}
+	}
+
+	if (multiDrawElementsIndirect != nullptr)
+	{
+		const size_t commandSize = commandCount * sizeof(DrawElementsIndirectCommand);
+		std::memcpy(commandStream->map(commandSize), frameCommands, commandSize);
+		commandStream->unmap();
+	}
+
+	commands = frameCommands;
+
+	return groupCount;
+}
+
+void InstanceBatcher::draw(const DrawGroup* groups, const unsigned int groupCount)
+{
+	if (multiDrawElementsIndirect != nullptr)
+	{
+		glBindBuffer(drawIndirectBuffer, commandStream->getBuffer());
+	}
+
+	for (unsigned int i = 0; i < groupCount; ++i)
+	{
+		const DrawGroup& group = groups[i];
+		const GeometryRange& range = group.mesh->getRange();
+		const GLenum indexType = range.indexSize == sizeof(unsigned short) ? GL_UNSIGNED_SHORT : GL_UNSIGNED_INT;
+		group.mesh->bindMaterial();
+		glState.setUniform(normalEncodingLocation, static_cast<int>(range.format));
+
+		// Impostors each have their own atlas, so they never share a group with anything else
+		const Impostor& impostor = group.mesh->getImpostor();
+		glState.setUniform(impostorFramesLocation, static_cast<int>(impostor.frames));
+
+		if (impostor.frames > 0)
+		{
+			glUniform4f(impostorBoundsLocation, impostor.bounds.x, impostor.bounds.y, impostor.bounds.z, impostor.bounds.w);
+		}
+
+		if (multiDrawElementsIndirect != nullptr)
+		{
+			// Commands carry their own first instance, so the instance attributes stay at the start of the buffer
+			pool->bindVertexArray(range.format, 0);
+			const size_t commandOffset = commandStream->getOffset() + group.firstCommand * sizeof(DrawElementsIndirectCommand);
+			multiDrawElementsIndirect(GL_TRIANGLES, indexType, (const void*)commandOffset, group.commandCount, 0);
+			continue;
+		}
+
+		for (unsigned int j = group.firstCommand; j < group.firstCommand + group.commandCount; ++j)
+		{
+			const DrawElementsIndirectCommand& command = commands[j];
+			pool->bindVertexArray(range.format, command.baseInstance * sizeof(InstanceData));
+			glDrawElementsInstancedBaseVertex(GL_TRIANGLES, command.count, indexType, (void*)(size_t)(command.firstIndex * range.indexSize),
+				command.instanceCount, command.baseVertex);
+		}
+	}
+
+	// Regions written this frame are only reused once the GPU is through with these draws
+	instanceStream.fence();
+
+	if (multiDrawElementsIndirect != nullptr)
+	{
+		commandStream->fence();
+	}
+}
+
+// Every mesh sharing a material gets the same number, so runs of them can be grouped by comparing numbers
+void InstanceBatcher::setChains(const std::vector<LODChain>& chains)
+{
+	std::vector<const Mesh*> materials;
+	bucketOffsets.clear();
+	bucketMeshes.clear();
+	meshDraws.clear();
+	bucketCount = 0;
+	maxClusterCount = 0;
+
+	for (unsigned int i = 0; i < chains.size(); ++i)
+	{
+		bucketOffsets.push_back(bucketCount);
+		bucketCount += chains[i].getLevelCount();
+
+		for (unsigned int level = 0; level < chains[i].getLevelCount(); ++level)
+		{
+			const std::vector<Mesh>& meshes = chains[i].getLevel(level).getMeshes();
+			bucketMeshes.push_back(static_cast<unsigned int>(meshDraws.size()));
+
+			for (unsigned int j = 0; j < meshes.size(); ++j)
+			{
+				unsigned int material = 0;
+
+				while (material < materials.size() && !materials[material]->sharesMaterial(meshes[j]))
+				{
+					material++;
+				}
+
+				if (material == materials.size())
+				{
+					materials.push_back(&meshes[j]);
+				}
+
+				meshDraws.push_back(MeshDraw{ &meshes[j], material, !meshes[j].getClusters().empty() });
+				maxClusterCount = std::max(maxClusterCount, static_cast<unsigned int>(meshes[j].getClusters().size()));
+			}
+		}
+	}
+
+	bucketMeshes.push_back(static_cast<unsigned int>(meshDraws.size()));
+}
+
+void InstanceBatcher::setClusterView(const ClusterView& view)
+{
+	clusterView = view;
+}
+
+bool InstanceBatcher::usesIndirectDraws() const
+{
+	return multiDrawElementsIndirect != nullptr;
+}
@@ -0,0 +1,88 @@
+#include <algorithm>
+
+#include "LODFader.h"
+
+const float minimumFade = 1.0f / 256.0f; // Fades are signed, so the incoming level never reaches 0 and flips to the outgoing pattern
+
+LODFader::LODFader(const unsigned int modelCount, const float duration)
+	: transitions(modelCount, Transition{ 0, 0, 0.0f }), duration(duration)
+{
+}
+
+bool LODFader::update(const unsigned int* modelChains, const unsigned int* modelLODs, const glm::mat4* modelMatrices, const float time,
+	FrameArena& arena, FadedDraws& draws)
+{
+	const unsigned int modelCount = static_cast<unsigned int>(transitions.size());
+	draws.chains = arena.allocate<unsigned int>(modelCount * 2);
+	draws.levels = arena.allocate<unsigned int>(modelCount * 2);
+	draws.matrices = arena.allocate<glm::mat4>(modelCount * 2);
+	draws.fades = arena.allocate<float>(modelCount * 2);
+	draws.count = 0;
+	fadingCount = 0;
+
+	if (draws.chains == nullptr || draws.levels == nullptr || draws.matrices == nullptr || draws.fades == nullptr)
+	{
+		return false;
+	}
+
+	for (unsigned int i = 0; i < modelCount; ++i)
+	{
+		Transition& transition = transitions[i];
+		float progress = duration > 0.0f ? (time - transition.start) / duration : 1.0f;
+
+		if (!started)
+		{
+			transition = Transition{ modelLODs[i], modelLODs[i], time };
+		}
+		else if (modelLODs[i] != transition.to)
+		{
+			if (progress < 1.0f && modelLODs[i] == transition.from)
+			{
+				// Heading back mid-transition picks up from the same blend rather than popping
+				transition = Transition{ transition.to, transition.from, time - (1.0f - progress) * duration };
+			}
+			else
+			{
+				// Otherwise the new transition starts from whichever level covers more of the model right now
+				transition = Transition{ progress < 0.5f ? transition.from : transition.to, modelLODs[i], time };
+			}
+		}
+
+		progress = duration > 0.0f ? (time - transition.start) / duration : 1.0f;
+
+		if (progress >= 1.0f || transition.from == transition.to)
+		{
+			transition.from = transition.to;
+			draws.chains[draws.count] = modelChains[i];
+			draws.levels[draws.count] = transition.to;
+			draws.matrices[draws.count] = modelMatrices[i];
+			draws.fades[draws.count++] = opaqueFade;
+			continue;
+		}
+
+		const float fade = std::max(progress, minimumFade);
+		draws.chains[draws.count] = modelChains[i];
+		draws.levels[draws.count] = transition.to;
+		draws.matrices[draws.count] = modelMatrices[i];
+		draws.fades[draws.count++] = fade;
+		draws.chains[draws.count] = modelChains[i];
+		draws.levels[draws.count] = transition.from;
+		draws.matrices[draws.count] = modelMatrices[i];
+		draws.fades[draws.count++] = -fade;
+		fadingCount++;
+	}
+
+	started = true;
+
+	return true;
+}
+
+unsigned int LODFader::getFadingCount() const
+{
+	return fadingCount;
+}
+
+void LODFader::setDuration(const float duration)
+{
+	this->duration = duration;
+}
@@ -0,0 +1,193 @@
+#include "LODStreamer.h"
+
+// Pool memory the meshes of a level take up
+static size_t measureLevel(const Model& model)
+{
+	const std::vector<Mesh>& meshes = model.getMeshes();
+	size_t bytes = 0;
+
+	for (unsigned int i = 0; i < meshes.size(); ++i)
+	{
+		const GeometryRange& range = meshes[i].getRange();
+		bytes += static_cast<size_t>(range.vertexCount) * getVertexStride(range.format) + static_cast<size_t>(range.indexCount) * range.indexSize;
+	}
+
+	return bytes;
+}
+
+LODStreamer::LODStreamer(WorkerPool& workers, const size_t budget)
+	: loader(workers), budget(budget)
+{
+}
+
+void LODStreamer::addLevel(const std::vector<LODChain>& chains, const unsigned int chain, const unsigned int level, const std::string& rootPath,
+	const std::string& fileName, const unsigned int shader, const float ratio, const ImportOptions& options)
+{
+	if (slots.size() < chains.size())
+	{
+		slots.resize(chains.size());
+	}
+
+	if (slots[chain].size() < chains[chain].getLevelCount())
+	{
+		slots[chain].resize(chains[chain].getLevelCount(), -1);
+	}
+
+	StreamedLevel streamed;
+	streamed.chain = chain;
+	streamed.level = level;
+	streamed.rootPath = rootPath;
+	streamed.fileName = fileName;
+	streamed.shader = shader;
+	streamed.ratio = ratio;
+	streamed.options = options;
+
+	// Simplified levels keep every mesh of the file in order, so mesh i of any level has the textures of mesh i of any other
+	for (unsigned int i = 0; i < chains[chain].getLevelCount() && streamed.textures.empty(); ++i)
+	{
+		const std::vector<Mesh>& meshes = chains[chain].getLevel(i).getMeshes();
+
+		for (unsigned int j = 0; j < meshes.size(); ++j)
+		{
+			streamed.textures.push_back(meshes[j].getTextures());
+		}
+	}
+
+	const Model& model = chains[chain].getLevel(level);
+	streamed.resident = !model.getMeshes().empty();
+	streamed.loading = false;
+	streamed.load = 0;
+	streamed.bytes = measureLevel(model);
+	streamed.lastUsed = frame;
+	residentBytes += streamed.bytes;
+
+	slots[chain][level] = static_cast<int>(levels.size());
+	levels.push_back(std::move(streamed));
+}
+
+LODStreamer::StreamedLevel* LODStreamer::find(const unsigned int chain, const unsigned int level)
+{
+	if (chain >= slots.size() || level >= slots[chain].size() || slots[chain][level] < 0)
+	{
+		return nullptr;
+	}
+
+	return &levels[slots[chain][level]];
+}
+
+bool LODStreamer::isResident(const unsigned int chain, const unsigned int level)
+{
+	const StreamedLevel* streamed = find(chain, level);
+	return streamed == nullptr || streamed->resident;
+}
+
+unsigned int LODStreamer::resolve(const std::vector<LODChain>& chains, const unsigned int chain, const unsigned int level)
+{
+	StreamedLevel* streamed = find(chain, level);
+
+	if (streamed == nullptr || streamed->resident)
+	{
+		return level;
+	}
+
+	if (!streamed->loading)
+	{
+		streamed->load = loader.queueLevel(streamed->rootPath, streamed->fileName, streamed->shader, streamed->ratio, streamed->textures, streamed->options);
+		streamed->loading = true;
+	}
+
+	const unsigned int levelCount = chains[chain].getLevelCount();
+
+	for (unsigned int distance = 1; distance < levelCount; ++distance)
+	{
+		if (level + distance < levelCount && isResident(chain, level + distance))
+		{
+			return level + distance;
+		}
+
+		if (distance <= level && isResident(chain, level - distance))
+		{
+			return level - distance;
+		}
+	}
+
+	return level; // Nothing to fall back on, so the model draws nothing until its level arrives
+}
+
+void LODStreamer::markUsed(const unsigned int chain, const unsigned int level)
+{
+	StreamedLevel* streamed = find(chain, level);
+
+	if (streamed != nullptr)
+	{
+		streamed->lastUsed = frame;
+	}
+}
+
+bool LODStreamer::update(std::vector<LODChain>& chains, GeometryPool& geometry)
+{
+	bool changed = false;
+	unsigned int load;
+	std::vector<Model> loaded;
+
+	while (loader.poll(geometry, load, loaded))
+	{
+		for (unsigned int i = 0; i < levels.size(); ++i)
+		{
+			StreamedLevel& streamed = levels[i];
+
+			if (streamed.loading && streamed.load == load)
+			{
+				chains[streamed.chain].getLevel(streamed.level) = std::move(loaded[0]);
+				streamed.resident = true;
+				streamed.loading = false;
+				streamed.bytes = measureLevel(chains[streamed.chain].getLevel(streamed.level));
+				streamed.lastUsed = frame;
+				residentBytes += streamed.bytes;
+				changed = true;
+				break;
+			}
+		}
+	}
+
+	// Levels drawn since the last update are kept even over budget, since evicting them would only have them load again
+	while (residentBytes > budget)
+	{
+		StreamedLevel* oldest = nullptr;
+
+		for (unsigned int i = 0; i < levels.size(); ++i)
+		{
+			if (levels[i].resident && levels[i].lastUsed < frame && (oldest == nullptr || levels[i].lastUsed < oldest->lastUsed))
+			{
+				oldest = &levels[i];
+			}
+		}
+
+		if (oldest == nullptr)
+		{
+			break;
+		}
+
+		// The placeholder keeps the level's error, which its chain's thresholds may have come from
+		Model& model = chains[oldest->chain].getLevel(oldest->level);
+		model = Model(std::vector<Mesh>{}, oldest->shader, model.getGeometricError());
+		oldest->resident = false;
+		residentBytes -= oldest->bytes;
+		oldest->bytes = 0;
+		changed = true;
+	}
+
+	frame++;
+
+	return changed;
+}
+
+size_t LODStreamer::getResidentBytes() const
+{
+	return residentBytes;
+}
+
+unsigned int LODStreamer::getLoadingCount() const
+{
+	return loader.getPendingCount();
+}
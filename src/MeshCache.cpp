@@ -0,0 +1,478 @@
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
+#include <atomic>
+#include <cstring>
+#include <limits>
+#include <fstream>
+#include <filesystem>
+#include <system_error>
+
+#include "MeshCache.h"
+
+const char meshCacheMagic[4] = { 'M', 'S', 'H', 'C' };
+
+struct MeshCacheHeader
+{
+	char magic[4];
+	uint32_t version;
+	uint64_t sourceSize;
+	int64_t sourceTime;
+	uint64_t settingsHash;
+	uint32_t meshCount;
+	uint32_t textureCount;
+	uint32_t dependencyCount;
+	uint32_t padding;
+};
+
+struct MeshRecord
+{
+	uint32_t nameLength;
+	uint32_t vertexCount;
+	uint32_t indexCount;
+	uint32_t textureCount;
+};
+
+static_assert(sizeof(MeshCacheHeader) == 48, "MeshCacheHeader should have no padding");
+static_assert(sizeof(Vertex) == 32, "Caches store vertices as they are in memory");
+
+// A read-only view of a whole file, unmapped when it goes out of scope
+class MappedFile
+{
+	public:
+		MappedFile(const std::string& path)
+		{
+#ifdef _WIN32
+			file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+			LARGE_INTEGER fileSize;
+
+			if (file == INVALID_HANDLE_VALUE || !GetFileSizeEx(file, &fileSize) || fileSize.QuadPart == 0)
+			{
+				return;
+			}
+
+			mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+
+			if (mapping != nullptr)
+			{
+				data = (const unsigned char*)MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+				size = data != nullptr ? static_cast<size_t>(fileSize.QuadPart) : 0;
+			}
+#else
+			descriptor = open(path.c_str(), O_RDONLY);
+			struct stat status;
+
+			if (descriptor < 0 || fstat(descriptor, &status) != 0 || status.st_size == 0)
+			{
+				return;
+			}
+
+			void* view = mmap(nullptr, static_cast<size_t>(status.st_size), PROT_READ, MAP_PRIVATE, descriptor, 0);
+
+			if (view != MAP_FAILED)
+			{
+				data = (const unsigned char*)view;
+				size = static_cast<size_t>(status.st_size);
+			}
+#endif
+		}
+
+		~MappedFile()
+		{
+#ifdef _WIN32
+			if (data != nullptr)
+			{
+				UnmapViewOfFile(data);
+			}
+
+			if (mapping != nullptr)
+			{
+				CloseHandle(mapping);
+			}
+
+			if (file != INVALID_HANDLE_VALUE)
+			{
+				CloseHandle(file);
+			}
+#else
+			if (data != nullptr)
+			{
+				munmap((void*)data, size);
+			}
+
+			if (descriptor >= 0)
+			{
+				close(descriptor);
+			}
+#endif
+		}
+
+		MappedFile(const MappedFile&) = delete;
+		MappedFile& operator=(const MappedFile&) = delete;
+
+		const unsigned char* data = nullptr;
+		size_t size = 0;
+
+	private:
+#ifdef _WIN32
+		HANDLE file = INVALID_HANDLE_VALUE;
+		HANDLE mapping = nullptr;
+#else
+		int descriptor = -1;
+#endif
+};
+
+// Reads through a mapped file, failing instead of reading past its end
+struct CacheReader
+{
+	const unsigned char* data;
+	size_t size;
+	size_t offset;
+
+	bool read(void* destination, const size_t count)
+	{
+		if (count > size - offset)
+		{
+			return false;
+		}
+
+		std::memcpy(destination, data + offset, count);
+		offset += count;
+		return true;
+	}
+
+	// Strings are padded so everything after them stays 4-byte aligned
+	bool readString(std::string& destination, const uint32_t length)
+	{
+		const size_t padded = (static_cast<size_t>(length) + 3) & ~static_cast<size_t>(3);
+
+		if (padded > size - offset)
+		{
+			return false;
+		}
+
+		destination.assign((const char*)data + offset, length);
+		offset += padded;
+		return true;
+	}
+
+	// False if count records of at least recordSize bytes each can't fit in what's left, so a corrupt count is never allocated for
+	bool fits(const uint32_t count, const size_t recordSize) const
+	{
+		return count <= (size - offset) / recordSize;
+	}
+};
+
+static void writeString(std::ofstream& output, const std::string& value)
+{
+	const uint32_t length = static_cast<uint32_t>(value.size());
+	const char padding[4] = {};
+	output.write((const char*)&length, sizeof(length));
+	output.write(value.data(), length);
+	output.write(padding, (4 - length % 4) % 4);
+}
+
+uint64_t hashBytes(const void* data, const size_t size, const uint64_t seed)
+{
+	const unsigned char* bytes = (const unsigned char*)data;
+	uint64_t hash = seed;
+
+	for (size_t i = 0; i < size; ++i)
+	{
+		hash = (hash ^ bytes[i]) * 1099511628211ull;
+	}
+
+	return hash;
+}
+
+// False if the file can't be found
+static bool findFileStamp(const std::string& path, uint64_t& size, int64_t& time)
+{
+	std::error_code error;
+	const uintmax_t fileSize = std::filesystem::file_size(path, error);
+
+	if (error)
+	{
+		return false;
+	}
+
+	const std::filesystem::file_time_type fileTime = std::filesystem::last_write_time(path, error);
+
+	if (error)
+	{
+		return false;
+	}
+
+	size = static_cast<uint64_t>(fileSize);
+	time = static_cast<int64_t>(fileTime.time_since_epoch().count());
+	return true;
+}
+
+static MeshCacheDependency findDependency(const std::string& path)
+{
+	MeshCacheDependency dependency;
+	dependency.path = path;
+
+	if (!findFileStamp(path, dependency.size, dependency.time))
+	{
+		dependency.size = std::numeric_limits<uint64_t>::max();
+		dependency.time = 0;
+	}
+
+	return dependency;
+}
+
+bool findMeshCacheKey(const std::string& sourcePath, const uint64_t settingsHash, MeshCacheKey& key)
+{
+	if (!findFileStamp(sourcePath, key.sourceSize, key.sourceTime))
+	{
+		return false;
+	}
+
+	key.settingsHash = settingsHash;
+	key.dependencies.clear();
+	return true;
+}
+
+void addMeshCacheDependency(const std::string& path, MeshCacheKey& key)
+{
+	for (unsigned int i = 0; i < key.dependencies.size(); ++i)
+	{
+		if (key.dependencies[i].path == path)
+		{
+			return;
+		}
+	}
+
+	key.dependencies.push_back(findDependency(path));
+}
+
+bool readMeshCache(const std::string& cachePath, const MeshCacheKey& key, std::vector<ImportedMesh>& meshes)
+{
+	const MappedFile file(cachePath);
+	CacheReader reader = { file.data, file.size, 0 };
+	MeshCacheHeader header;
+
+	if (file.data == nullptr || !reader.read(&header, sizeof(header)) || std::memcmp(header.magic, meshCacheMagic, sizeof(meshCacheMagic)) != 0 ||
+		header.version != meshCacheVersion || header.sourceSize != key.sourceSize || header.sourceTime != key.sourceTime || header.settingsHash != key.settingsHash)
+	{
+		return false;
+	}
+
+	for (uint32_t i = 0; i < header.dependencyCount; ++i)
+	{
+		MeshCacheDependency stored;
+		uint32_t length;
+
+		if (!reader.read(&stored.size, sizeof(stored.size)) || !reader.read(&stored.time, sizeof(stored.time)) || !reader.read(&length, sizeof(length)) ||
+			!reader.readString(stored.path, length))
+		{
+			return false;
+		}
+
+		const MeshCacheDependency current = findDependency(stored.path);
+
+		if (current.size != stored.size || current.time != stored.time)
+		{
+			return false;
+		}
+	}
+
+	// Every count is checked against the smallest its records could take before anything is allocated for them
+	if (!reader.fits(header.textureCount, 2 * sizeof(uint32_t)))
+	{
+		return false;
+	}
+
+	std::vector<Texture> textures(header.textureCount);
+
+	for (uint32_t i = 0; i < header.textureCount; ++i)
+	{
+		uint32_t isSpecular, length;
+
+		if (!reader.read(&isSpecular, sizeof(isSpecular)) || !reader.read(&length, sizeof(length)) || !reader.readString(textures[i].file, length))
+		{
+			return false;
+		}
+
+		textures[i].isSpecular = isSpecular != 0;
+	}
+
+	if (!reader.fits(header.meshCount, sizeof(MeshRecord)))
+	{
+		return false;
+	}
+
+	std::vector<ImportedMesh> result(header.meshCount);
+
+	for (uint32_t i = 0; i < header.meshCount; ++i)
+	{
+		ImportedMesh& mesh = result[i];
+		MeshRecord record;
+
+		if (!reader.read(&record, sizeof(record)) || !reader.readString(mesh.name, record.nameLength))
+		{
+			return false;
+		}
+
+		if (!reader.fits(record.textureCount, 2 * sizeof(uint32_t)))
+		{
+			return false;
+		}
+
+		mesh.textures.resize(record.textureCount);
+
+		for (uint32_t j = 0; j < record.textureCount; ++j)
+		{
+			uint32_t texture, length;
+
+			if (!reader.read(&texture, sizeof(texture)) || texture >= header.textureCount || !reader.read(&length, sizeof(length)))
+			{
+				return false;
+			}
+
+			mesh.textures[j] = textures[texture];
+
+			if (!reader.readString(mesh.textures[j].uniform, length))
+			{
+				return false;
+			}
+		}
+
+		const size_t vertexBytes = static_cast<size_t>(record.vertexCount) * sizeof(Vertex);
+		const size_t indexBytes = static_cast<size_t>(record.indexCount) * sizeof(unsigned int);
+
+		if (vertexBytes + indexBytes > reader.size - reader.offset)
+		{
+			return false;
+		}
+
+		mesh.vertices.resize(record.vertexCount);
+		mesh.indices.resize(record.indexCount);
+		reader.read(mesh.vertices.data(), vertexBytes);
+		reader.read(mesh.indices.data(), indexBytes);
+
+		for (uint32_t j = 0; j < record.indexCount; ++j)
+		{
+			if (mesh.indices[j] >= record.vertexCount)
+			{
+				return false;
+			}
+		}
+	}
+
+	meshes = std::move(result);
+	return true;
+}
+
+bool writeMeshCache(const std::string& cachePath, const MeshCacheKey& key, const std::vector<ImportedMesh>& meshes)
+{
+	// Written under a name of its own and renamed into place once complete, since another thread may be reading or writing the same cache
+	static std::atomic<unsigned int> writeCount{ 0 };
+	const std::string writePath = cachePath + "." + std::to_string(writeCount++) + ".tmp";
+	std::ofstream output(writePath, std::ios::binary | std::ios::trunc);
+
+	if (!output)
+	{
+		return false;
+	}
+
+	// Every texture file is stored once, and meshes refer to them by their place in the table
+	std::vector<const Texture*> table;
+	std::vector<std::vector<uint32_t>> references(meshes.size());
+
+	for (unsigned int i = 0; i < meshes.size(); ++i)
+	{
+		for (unsigned int j = 0; j < meshes[i].textures.size(); ++j)
+		{
+			const Texture& texture = meshes[i].textures[j];
+			uint32_t index = 0;
+
+			while (index < table.size() && (table[index]->file != texture.file || table[index]->isSpecular != texture.isSpecular))
+			{
+				index++;
+			}
+
+			if (index == table.size())
+			{
+				table.push_back(&texture);
+			}
+
+			references[i].push_back(index);
+		}
+	}
+
+	MeshCacheHeader header = {};
+	output.write((const char*)&header, sizeof(header));
+
+	for (unsigned int i = 0; i < key.dependencies.size(); ++i)
+	{
+		output.write((const char*)&key.dependencies[i].size, sizeof(uint64_t));
+		output.write((const char*)&key.dependencies[i].time, sizeof(int64_t));
+		writeString(output, key.dependencies[i].path);
+	}
+
+	for (unsigned int i = 0; i < table.size(); ++i)
+	{
+		const uint32_t isSpecular = table[i]->isSpecular ? 1 : 0;
+		output.write((const char*)&isSpecular, sizeof(isSpecular));
+		writeString(output, table[i]->file);
+	}
+
+	for (unsigned int i = 0; i < meshes.size(); ++i)
+	{
+		const ImportedMesh& mesh = meshes[i];
+		const MeshRecord record = { static_cast<uint32_t>(mesh.name.size()), static_cast<uint32_t>(mesh.vertices.size()),
+			static_cast<uint32_t>(mesh.indices.size()), static_cast<uint32_t>(mesh.textures.size()) };
+		output.write((const char*)&record, sizeof(record));
+		output.write(mesh.name.data(), mesh.name.size());
+		output.write("\0\0\0", (4 - mesh.name.size() % 4) % 4);
+
+		for (unsigned int j = 0; j < mesh.textures.size(); ++j)
+		{
+			output.write((const char*)&references[i][j], sizeof(uint32_t));
+			writeString(output, mesh.textures[j].uniform);
+		}
+
+		output.write((const char*)mesh.vertices.data(), mesh.vertices.size() * sizeof(Vertex));
+		output.write((const char*)mesh.indices.data(), mesh.indices.size() * sizeof(unsigned int));
+	}
+
+	std::memcpy(header.magic, meshCacheMagic, sizeof(meshCacheMagic));
+	header.version = meshCacheVersion;
+	header.sourceSize = key.sourceSize;
+	header.sourceTime = key.sourceTime;
+	header.settingsHash = key.settingsHash;
+	header.meshCount = static_cast<uint32_t>(meshes.size());
+	header.textureCount = static_cast<uint32_t>(table.size());
+	header.dependencyCount = static_cast<uint32_t>(key.dependencies.size());
+	output.seekp(0);
+	output.write((const char*)&header, sizeof(header));
+	output.close();
+
+	std::error_code error;
+
+	if (!output)
+	{
+		std::filesystem::remove(writePath, error);
+		return false;
+	}
+
+	std::filesystem::rename(writePath, cachePath, error);
+
+	if (error)
+	{
+		std::filesystem::remove(writePath, error);
+		return false;
+	}
+
+	return true;
+}
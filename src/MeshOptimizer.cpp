@@ -0,0 +1,509 @@
+#include <glm/glm.hpp>
+
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <algorithm>
+#include <unordered_map>
+
+#include "MeshOptimizer.h"
+
+const unsigned int forsythCacheSize = 32; // Modeled LRU cache size when scoring vertices
+const float cacheDecayPower = 1.5f;
+const float lastTriangleScore = 0.75f;
+const float valenceBoostScale = 2.0f;
+const float valenceBoostPower = 0.5f;
+
+float computeACMR(const std::vector<unsigned int>& indices, const unsigned int vertexCount, const unsigned int cacheSize)
+{
+	if (indices.empty())
+	{
+		return 0.0f;
+	}
+
+	// A vertex is still cached if fewer than cacheSize misses have happened since it was last loaded
+	std::vector<unsigned int> loadedAt(vertexCount, 0);
+	unsigned int timestamp = cacheSize + 1;
+	unsigned int misses = 0;
+
+	for (unsigned int i = 0; i < indices.size(); ++i)
+	{
+		const unsigned int vertex = indices[i];
+
+		if (timestamp - loadedAt[vertex] > cacheSize)
+		{
+			loadedAt[vertex] = timestamp++;
+			misses++;
+		}
+	}
+
+	return static_cast<float>(misses) / static_cast<float>(indices.size() / 3);
+}
+
+static float scoreVertex(const int cachePosition, const unsigned int remainingTriangles)
+{
+	if (remainingTriangles == 0)
+	{
+		return -1.0f;
+	}
+
+	float score = 0.0f;
+
+	if (cachePosition >= 0)
+	{
+		// The last triangle's vertices score lower so the next triangle doesn't just reuse the same edge
+		if (cachePosition < 3)
+		{
+			score = lastTriangleScore;
+		}
+		else
+		{
+			const float scale = 1.0f / (forsythCacheSize - 3);
+			score = std::pow(1.0f - (cachePosition - 3) * scale, cacheDecayPower);
+		}
+	}
+
+	// Vertices with few triangles left are worth finishing off
+	return score + valenceBoostScale * std::pow(static_cast<float>(remainingTriangles), -valenceBoostPower);
+}
+
+void optimizeVertexCache(std::vector<unsigned int>& indices, const unsigned int vertexCount)
+{
+	const unsigned int triangleCount = static_cast<unsigned int>(indices.size() / 3);
+
+	if (triangleCount == 0)
+	{
+		return;
+	}
+
+	// Triangles adjacent to each vertex, with the ones still to be emitted at the front of each vertex's range
+	std::vector<unsigned int> adjacencyOffsets(vertexCount + 1, 0);
+	std::vector<unsigned int> remaining(vertexCount, 0);
+
+	for (unsigned int i = 0; i < indices.size(); ++i)
+	{
+		remaining[indices[i]]++;
+	}
+
+	for (unsigned int i = 0; i < vertexCount; ++i)
+	{
+		adjacencyOffsets[i + 1] = adjacencyOffsets[i] + remaining[i];
+	}
+
+	std::vector<unsigned int> adjacency(indices.size());
+	std::vector<unsigned int> filled(adjacencyOffsets.begin(), adjacencyOffsets.end() - 1);
+
+	for (unsigned int i = 0; i < triangleCount; ++i)
+	{
+		for (unsigned int j = 0; j < 3; ++j)
+		{
+			const unsigned int vertex = indices[i * 3 + j];
+			adjacency[filled[vertex]++] = i;
+		}
+	}
+
+	std::vector<int> cachePositions(vertexCount, -1);
+	std::vector<float> vertexScores(vertexCount);
+	std::vector<float> triangleScores(triangleCount, 0.0f);
+	std::vector<bool> emitted(triangleCount, false);
+
+	for (unsigned int i = 0; i < vertexCount; ++i)
+	{
+		vertexScores[i] = scoreVertex(-1, remaining[i]);
+	}
+
+	for (unsigned int i = 0; i < triangleCount; ++i)
+	{
+		for (unsigned int j = 0; j < 3; ++j)
+		{
+			triangleScores[i] += vertexScores[indices[i * 3 + j]];
+		}
+	}
+
+	std::vector<unsigned int> result;
+	result.reserve(indices.size());
+	std::vector<unsigned int> cache;
+	std::vector<unsigned int> nextCache;
+	cache.reserve(forsythCacheSize + 3);
+	nextCache.reserve(forsythCacheSize + 3);
+
+	unsigned int nextUnemitted = 0;
+	int bestTriangle = 0;
+
+	for (unsigned int emittedCount = 0; emittedCount < triangleCount; ++emittedCount)
+	{
+		// Nothing in the cache has triangles left, so continue from the first triangle in input order that hasn't been emitted
+		if (bestTriangle < 0)
+		{
+			while (emitted[nextUnemitted])
+			{
+				nextUnemitted++;
+			}
+
+			bestTriangle = static_cast<int>(nextUnemitted);
+		}
+
+		const unsigned int triangle = static_cast<unsigned int>(bestTriangle);
+		emitted[triangle] = true;
+		nextCache.clear();
+
+		for (unsigned int j = 0; j < 3; ++j)
+		{
+			const unsigned int vertex = indices[triangle * 3 + j];
+			result.push_back(vertex);
+			nextCache.push_back(vertex);
+
+			// Move the triangle out of the vertex's remaining range
+			const unsigned int begin = adjacencyOffsets[vertex];
+			const unsigned int end = begin + remaining[vertex];
+
+			for (unsigned int k = begin; k < end; ++k)
+			{
+				if (adjacency[k] == triangle)
+				{
+					std::swap(adjacency[k], adjacency[end - 1]);
+					break;
+				}
+			}
+
+			remaining[vertex]--;
+		}
+
+		for (unsigned int j = 0; j < cache.size(); ++j)
+		{
+			const unsigned int vertex = cache[j];
+
+			if (std::find(nextCache.begin(), nextCache.begin() + 3, vertex) == nextCache.begin() + 3)
+			{
+				nextCache.push_back(vertex);
+			}
+		}
+
+		// Vertices pushed out of the modeled cache lose their cache score
+		for (unsigned int j = 0; j < cache.size(); ++j)
+		{
+			cachePositions[cache[j]] = -1;
+		}
+
+		for (unsigned int j = 0; j < nextCache.size(); ++j)
+		{
+			if (j < forsythCacheSize)
+			{
+				cachePositions[nextCache[j]] = static_cast<int>(j);
+			}
+		}
+
+		// Rescore everything that was or now is cached, and find the best triangle touching any of it
+		float bestScore = -1.0f;
+		bestTriangle = -1;
+
+		for (unsigned int j = 0; j < nextCache.size(); ++j)
+		{
+			const unsigned int vertex = nextCache[j];
+			const float score = scoreVertex(cachePositions[vertex], remaining[vertex]);
+			const float difference = score - vertexScores[vertex];
+			vertexScores[vertex] = score;
+
+			const unsigned int begin = adjacencyOffsets[vertex];
+
+			for (unsigned int k = begin; k < begin + remaining[vertex]; ++k)
+			{
+				const unsigned int adjacent = adjacency[k];
+				triangleScores[adjacent] += difference;
+
+				if (triangleScores[adjacent] > bestScore || (triangleScores[adjacent] == bestScore && static_cast<int>(adjacent) < bestTriangle))
+				{
+					bestScore = triangleScores[adjacent];
+					bestTriangle = static_cast<int>(adjacent);
+				}
+			}
+		}
+
+		if (nextCache.size() > forsythCacheSize)
+		{
+			nextCache.resize(forsythCacheSize);
+		}
+
+		std::swap(cache, nextCache);
+	}
+
+	indices.swap(result);
+}
+
+// Counts misses over a range of triangles starting from an empty cache
+static unsigned int countMisses(const std::vector<unsigned int>& indices, const unsigned int firstTriangle, const unsigned int endTriangle, std::vector<unsigned int>& loadedAt, unsigned int& timestamp)
+{
+	timestamp += simulatedCacheSize + 1;
+	unsigned int misses = 0;
+
+	for (unsigned int i = firstTriangle * 3; i < endTriangle * 3; ++i)
+	{
+		const unsigned int vertex = indices[i];
+
+		if (timestamp - loadedAt[vertex] > simulatedCacheSize)
+		{
+			loadedAt[vertex] = timestamp++;
+			misses++;
+		}
+	}
+
+	return misses;
+}
+
+void optimizeOverdraw(std::vector<unsigned int>& indices, const std::vector<Vertex>& vertices, const float threshold)
+{
+	const unsigned int triangleCount = static_cast<unsigned int>(indices.size() / 3);
+
+	if (triangleCount < 2)
+	{
+		return;
+	}
+
+	// Hard boundaries are where the cache starts over anyway, since every vertex of the triangle misses
+	std::vector<unsigned int> loadedAt(vertices.size(), 0);
+	unsigned int timestamp = simulatedCacheSize + 1;
+	std::vector<unsigned int> hardBoundaries;
+
+	for (unsigned int i = 0; i < triangleCount; ++i)
+	{
+		unsigned int misses = 0;
+
+		for (unsigned int j = 0; j < 3; ++j)
+		{
+			const unsigned int vertex = indices[i * 3 + j];
+
+			if (timestamp - loadedAt[vertex] > simulatedCacheSize)
+			{
+				loadedAt[vertex] = timestamp++;
+				misses++;
+			}
+		}
+
+		if (misses == 3 || i == 0)
+		{
+			hardBoundaries.push_back(i);
+		}
+	}
+
+	hardBoundaries.push_back(triangleCount);
+
+	// Soft boundaries split hard clusters wherever starting over keeps the cluster within threshold of its own ACMR
+	std::vector<unsigned int> clusters;
+
+	for (unsigned int i = 0; i + 1 < hardBoundaries.size(); ++i)
+	{
+		const unsigned int start = hardBoundaries[i];
+		const unsigned int end = hardBoundaries[i + 1];
+		const float clusterThreshold = threshold * countMisses(indices, start, end, loadedAt, timestamp) / static_cast<float>(end - start);
+
+		clusters.push_back(start);
+		timestamp += simulatedCacheSize + 1;
+		unsigned int clusterStart = start;
+		unsigned int misses = 0;
+
+		for (unsigned int triangle = start; triangle < end; ++triangle)
+		{
+			for (unsigned int j = 0; j < 3; ++j)
+			{
+				const unsigned int vertex = indices[triangle * 3 + j];
+
+				if (timestamp - loadedAt[vertex] > simulatedCacheSize)
+				{
+					loadedAt[vertex] = timestamp++;
+					misses++;
+				}
+			}
+
+			if (triangle + 1 < end && misses <= clusterThreshold * (triangle + 1 - clusterStart))
+			{
+				clusters.push_back(triangle + 1);
+				clusterStart = triangle + 1;
+				timestamp += simulatedCacheSize + 1;
+				misses = 0;
+			}
+		}
+	}
+
+	clusters.push_back(triangleCount);
+
+	// Sort clusters by how far they face away from the middle of the mesh, so outer surfaces occlude inner ones
+	glm::vec3 meshCenter(0.0f);
+	float meshArea = 0.0f;
+	std::vector<float> sortKeys(clusters.size() - 1);
+
+	for (unsigned int i = 0; i < triangleCount; ++i)
+	{
+		const glm::vec3& a = vertices[indices[i * 3]].position;
+		const glm::vec3& b = vertices[indices[i * 3 + 1]].position;
+		const glm::vec3& c = vertices[indices[i * 3 + 2]].position;
+		const float area = glm::length(glm::cross(b - a, c - a));
+		meshCenter += (a + b + c) * (area / 3.0f);
+		meshArea += area;
+	}
+
+	meshCenter = meshArea > 0.0f ? meshCenter / meshArea : meshCenter;
+
+	for (unsigned int i = 0; i + 1 < clusters.size(); ++i)
+	{
+		glm::vec3 center(0.0f);
+		glm::vec3 normal(0.0f);
+		float area = 0.0f;
+
+		for (unsigned int triangle = clusters[i]; triangle < clusters[i + 1]; ++triangle)
+		{
+			const glm::vec3& a = vertices[indices[triangle * 3]].position;
+			const glm::vec3& b = vertices[indices[triangle * 3 + 1]].position;
+			const glm::vec3& c = vertices[indices[triangle * 3 + 2]].position;
+			const glm::vec3 areaNormal = glm::cross(b - a, c - a);
+			const float triangleArea = glm::length(areaNormal);
+
+			center += (a + b + c) * (triangleArea / 3.0f);
+			normal += areaNormal;
+			area += triangleArea;
+		}
+
+		center = area > 0.0f ? center / area : center;
+		const float normalLength = glm::length(normal);
+		sortKeys[i] = normalLength > 0.0f ? glm::dot(center - meshCenter, normal / normalLength) : 0.0f;
+	}
+
+	std::vector<unsigned int> order(sortKeys.size());
+
+	for (unsigned int i = 0; i < order.size(); ++i)
+	{
+		order[i] = i;
+	}
+
+	std::stable_sort(order.begin(), order.end(), [&sortKeys](const unsigned int a, const unsigned int b) { return sortKeys[a] > sortKeys[b]; });
+
+	std::vector<unsigned int> result;
+	result.reserve(indices.size());
+
+	for (unsigned int i = 0; i < order.size(); ++i)
+	{
+		result.insert(result.end(), indices.begin() + clusters[order[i]] * 3, indices.begin() + clusters[order[i] + 1] * 3);
+	}
+
+	indices.swap(result);
+}
+
+void optimizeVertexFetch(std::vector<Vertex>& vertices, std::vector<unsigned int>& indices)
+{
+	const unsigned int unused = static_cast<unsigned int>(-1);
+	std::vector<unsigned int> remap(vertices.size(), unused);
+	std::vector<Vertex> result;
+	result.reserve(vertices.size());
+
+	for (unsigned int i = 0; i < indices.size(); ++i)
+	{
+		unsigned int& index = remap[indices[i]];
+
+		if (index == unused)
+		{
+			index = static_cast<unsigned int>(result.size());
+			result.push_back(vertices[indices[i]]);
+		}
+
+		indices[i] = index;
+	}
+
+	vertices.swap(result);
+}
+
+// Attributes of a vertex rounded to multiples of their weld tolerances
+struct WeldKey
+{
+	int64_t values[8];
+
+	bool operator==(const WeldKey& other) const
+	{
+		return std::memcmp(values, other.values, sizeof(values)) == 0;
+	}
+};
+
+struct WeldKeyHash
+{
+	size_t operator()(const WeldKey& key) const
+	{
+		uint64_t hash = 14695981039346656037ull;
+
+		for (unsigned int i = 0; i < 8; ++i)
+		{
+			hash = (hash ^ static_cast<uint64_t>(key.values[i])) * 1099511628211ull;
+		}
+
+		return static_cast<size_t>(hash ^ hash >> 32);
+	}
+};
+
+static int64_t quantize(const float value, const float tolerance)
+{
+	if (tolerance <= 0.0f)
+	{
+		uint32_t bits;
+		std::memcpy(&bits, &value, sizeof(bits));
+		return bits;
+	}
+
+	return std::llround(value / tolerance);
+}
+
+unsigned int weldVertices(std::vector<Vertex>& vertices, std::vector<unsigned int>& indices, const WeldTolerances& tolerances)
+{
+	const unsigned int vertexCount = static_cast<unsigned int>(vertices.size());
+	std::unordered_map<WeldKey, unsigned int, WeldKeyHash> welded;
+	std::unordered_map<WeldKey, glm::vec3, WeldKeyHash> snappedPositions;
+	welded.reserve(vertexCount);
+	snappedPositions.reserve(vertexCount);
+
+	std::vector<unsigned int> remap(vertexCount);
+	unsigned int weldedCount = 0;
+
+	for (unsigned int i = 0; i < vertexCount; ++i)
+	{
+		Vertex vertex = vertices[i];
+		WeldKey key = {
+			quantize(vertex.position.x, tolerances.position), quantize(vertex.position.y, tolerances.position), quantize(vertex.position.z, tolerances.position),
+			0, 0, 0, 0, 0
+		};
+
+		vertex.position = snappedPositions.emplace(key, vertex.position).first->second;
+		key.values[3] = quantize(vertex.normal.x, tolerances.normal);
+		key.values[4] = quantize(vertex.normal.y, tolerances.normal);
+		key.values[5] = quantize(vertex.normal.z, tolerances.normal);
+		key.values[6] = quantize(vertex.texCoords.x, tolerances.texCoords);
+		key.values[7] = quantize(vertex.texCoords.y, tolerances.texCoords);
+
+		auto inserted = welded.emplace(key, weldedCount);
+
+		if (inserted.second)
+		{
+			vertices[weldedCount++] = vertex;
+		}
+
+		remap[i] = inserted.first->second;
+	}
+
+	vertices.resize(weldedCount);
+
+	for (unsigned int i = 0; i < indices.size(); ++i)
+	{
+		indices[i] = remap[indices[i]];
+	}
+
+	return weldedCount;
+}
+
+OptimizationStats optimizeMesh(std::vector<Vertex>& vertices, std::vector<unsigned int>& indices)
+{
+	OptimizationStats stats;
+	const unsigned int vertexCount = static_cast<unsigned int>(vertices.size());
+	stats.acmrBefore = computeACMR(indices, vertexCount);
+
+	optimizeVertexCache(indices, vertexCount);
+	optimizeOverdraw(indices, vertices);
+	optimizeVertexFetch(vertices, indices);
+
+	stats.acmrAfter = computeACMR(indices, static_cast<unsigned int>(vertices.size()));
+	return stats;
+}
@@ -1,97 +1,318 @@
 #include <glad/glad.h>
 
+#include <cmath>
+#include <cassert>
+#include <utility>
+#include <algorithm>
+
 #include "Model.h"
+#include "GLState.h"
 
 Texture::Texture()
-    : isSpecular(false), id(0), file(nullptr), uniform(nullptr)
+    : isSpecular(false), id(0)
 {
 }
 
-Texture::Texture(unsigned int id, bool isSpecular, const char* file, const char* uniform)
+Texture::Texture(unsigned int id, bool isSpecular, const char* file, const std::string& uniform)
 	: isSpecular(isSpecular), id(id), file(file), uniform(uniform)
 {
 }
 
-Mesh::Mesh(const std::vector<Vertex>& vertices, const std::vector<unsigned int>& indices,const std::vector<Texture>& textures)
-    : vertices(vertices), indices(indices), textures(textures), samplers(std::vector<int>{})
+Mesh::Mesh(GeometryPool& pool, std::vector<Vertex>&& vertices, std::vector<unsigned int>&& indices, std::vector<Texture>&& textures,
+    const VertexFormat preferredFormat, const bool retainGeometry)
+    : vertices(std::move(vertices)), indices(std::move(indices)), textures(std::move(textures)), samplers(std::vector<int>{}), pool(&pool)
 {
-	glGenVertexArrays(1, &vertexArray);
-    glGenBuffers(1, &vertexBuffer);
-    glGenBuffers(1, &elementBuffer);
-  
-    glBindVertexArray(vertexArray);
-    glBindBuffer(GL_ARRAY_BUFFER, vertexBuffer);
-    glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(Vertex), &vertices[0], GL_STATIC_DRAW);  
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, elementBuffer);
-    glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(unsigned int), &indices[0], GL_STATIC_DRAW);
+    bounds = findQuantization(this->vertices);
+    const VertexFormat format = chooseVertexFormat(this->vertices, bounds, preferredFormat);
+
+    // Full precision positions need no decoding, so they keep the default offset and scale
+    if (format != VertexFormat::Full)
+    {
+        quantization = bounds;
+    }
+
+    const std::vector<unsigned char> vertexData = encodeVertices(this->vertices, format, quantization);
+    range = pool.allocate(format, vertexData, static_cast<unsigned int>(this->vertices.size()), this->indices);
+
+    // Drawing only needs the range once everything is on the GPU
+    if (!retainGeometry)
+    {
+        std::vector<Vertex>().swap(this->vertices);
+        std::vector<unsigned int>().swap(this->indices);
+    }
+}
 
-    // vertex positions
-    size_t size = sizeof(Vertex);
-    glEnableVertexAttribArray(0);	
-    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, size, (void*)0);
-    // vertex normals
-    glEnableVertexAttribArray(1);	
-    glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, size, (void*)offsetof(Vertex, normal));
-    // vertex texture coords
-    glEnableVertexAttribArray(2);	
-    glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, size, (void*)offsetof(Vertex, texCoords));
+Mesh::~Mesh()
+{
+    release();
+}
 
-    glBindVertexArray(0);
+Mesh::Mesh(Mesh&& other) noexcept
+    : vertices(std::move(other.vertices)), indices(std::move(other.indices)), textures(std::move(other.textures)), samplers(std::move(other.samplers)),
+    clusters(std::move(other.clusters)), impostor(other.impostor), pool(other.pool), range(other.range), quantization(other.quantization), bounds(other.bounds)
+{
+    other.pool = nullptr;
+}
+
+Mesh& Mesh::operator=(Mesh&& other) noexcept
+{
+    if (this != &other)
+    {
+        release();
+
+        vertices = std::move(other.vertices);
+        indices = std::move(other.indices);
+        textures = std::move(other.textures);
+        samplers = std::move(other.samplers);
+        clusters = std::move(other.clusters);
+        impostor = other.impostor;
+        pool = other.pool;
+        range = other.range;
+        quantization = other.quantization;
+        bounds = other.bounds;
+
+        other.pool = nullptr;
+    }
+
+    return *this;
 }
 
 void Mesh::setup(const unsigned int shader)
 {
     // Investigate samplers count not matching textures
+    samplers.clear();
+
 	for (unsigned int i = 0; i < textures.size(); ++i)
 	{
-		samplers.push_back(glGetUniformLocation(shader, textures[i].uniform));
+		samplers.push_back(glGetUniformLocation(shader, textures[i].uniform.c_str()));
 	}
 }
 
-void Mesh::draw() const
+void Mesh::bindMaterial() const
 {
 	for (unsigned int i = 0; i < samplers.size(); ++i)
 	{
-		glActiveTexture(GL_TEXTURE0 + i);
-		glBindTexture(GL_TEXTURE_2D, textures[i].id);
-		glUniform1i(samplers[i], i); // Set uniform sampler in shader
+		glState.bindTexture(i, textures[i].isArray ? GL_TEXTURE_2D_ARRAY : GL_TEXTURE_2D, textures[i].id);
+		glState.setUniform(samplers[i], i); // Set uniform sampler in shader
+	}
+
+	if (impostor.atlas != 0)
+	{
+		glState.bindTexture(impostorTextureUnit, GL_TEXTURE_2D, impostor.atlas);
 	}
+}
+
+// Levels of detail generated from one mesh keep its textures, and meshes with textures packed into the same arrays only differ
+// in layers, which are drawn per instance, so either can be drawn together
+bool Mesh::sharesMaterial(const Mesh& other) const
+{
+    if (textures.size() != other.textures.size() || impostor.atlas != other.impostor.atlas)
+    {
+        return false;
+    }
+
+    for (unsigned int i = 0; i < textures.size(); ++i)
+    {
+        if (textures[i].id != other.textures[i].id || textures[i].isArray != other.textures[i].isArray || textures[i].uniform != other.textures[i].uniform)
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+bool Mesh::hasGeometry() const
+{
+    return !vertices.empty();
+}
+
+const std::vector<Vertex>& Mesh::getVertices() const
+{
+    return vertices;
+}
+
+const std::vector<unsigned int>& Mesh::getIndices() const
+{
+    return indices;
+}
 
-	glBindVertexArray(vertexArray);
-	glDrawElements(GL_TRIANGLES, static_cast<unsigned int>(indices.size()), GL_UNSIGNED_INT, 0);
+const GeometryRange& Mesh::getRange() const
+{
+    return range;
+}
 
-    glBindVertexArray(0);
-    glActiveTexture(GL_TEXTURE0);
+const VertexQuantization& Mesh::getQuantization() const
+{
+    return quantization;
 }
 
-void Mesh::cleanUp()
+const std::vector<Texture>& Mesh::getTextures() const
 {
-	glDeleteVertexArrays(1, &vertexArray);
-    glDeleteBuffers(1, &vertexBuffer);
-    glDeleteBuffers(1, &elementBuffer);
+    return textures;
 }
 
-Model::Model(std::vector<Mesh> meshes, const unsigned int shader)
-	: meshes(meshes)
+std::vector<Texture>& Mesh::getTextures()
 {
-    for (unsigned int i = 0; i < meshes.size(); ++i)
+    return textures;
+}
+
+glm::vec2 Mesh::getTextureLayers() const
+{
+    glm::vec2 layers(0.0f);
+    bool foundDiffuse = false, foundSpecular = false;
+
+    for (unsigned int i = 0; i < textures.size(); ++i)
     {
-        meshes[i].setup(shader);
+        bool& found = textures[i].isSpecular ? foundSpecular : foundDiffuse;
+
+        if (!found)
+        {
+            layers[textures[i].isSpecular ? 1 : 0] = static_cast<float>(textures[i].layer);
+            found = true;
+        }
     }
+
+    return layers;
 }
 
-void Model::draw() const
+void Mesh::setClusters(std::vector<Cluster>&& clusters)
 {
-	for (unsigned int i = 0; i < meshes.size(); ++i)
-	{
-		meshes[i].draw();
-	}
+    this->clusters = std::move(clusters);
 }
 
-void Model::cleanUp()
+const std::vector<Cluster>& Mesh::getClusters() const
 {
-    for (unsigned int i = 0; i < meshes.size(); ++i)
+    return clusters;
+}
+
+void Mesh::setImpostor(const Impostor& impostor)
+{
+    this->impostor = impostor;
+}
+
+const Impostor& Mesh::getImpostor() const
+{
+    return impostor;
+}
+
+const VertexQuantization& Mesh::getBounds() const
+{
+    return bounds;
+}
+
+// Moved-from meshes own nothing
+void Mesh::release()
+{
+    if (pool != nullptr)
+    {
+        pool->free(range);
+        pool = nullptr;
+    }
+}
+
+Model::Model(std::vector<Mesh>&& meshes, const unsigned int shader, const float geometricError)
+	: meshes(std::move(meshes)), geometricError(geometricError)
+{
+    for (unsigned int i = 0; i < this->meshes.size(); ++i)
+    {
+        this->meshes[i].setup(shader);
+    }
+}
+
+const std::vector<Mesh>& Model::getMeshes() const
+{
+    return meshes;
+}
+
+std::vector<Mesh>& Model::getMeshes()
+{
+    return meshes;
+}
+
+float Model::getGeometricError() const
+{
+    return geometricError;
+}
+
+// One threshold between each pair of neighboring levels, never decreasing, since selectLevel reads exactly that many
+static bool areThresholdsValid(const size_t levelCount, const std::vector<unsigned int>& thresholds)
+{
+    return thresholds.size() + 1 == std::max<size_t>(levelCount, 1) && std::is_sorted(thresholds.begin(), thresholds.end());
+}
+
+LODChain::LODChain(std::vector<Model> levels, std::vector<unsigned int> thresholds)
+    : levels(std::move(levels)), thresholds(std::move(thresholds))
+{
+    if (this->thresholds.empty())
+    {
+        for (unsigned int i = 1; i < this->levels.size(); ++i)
+        {
+            this->thresholds.push_back(i);
+        }
+    }
+
+    assert(areThresholdsValid(this->levels.size(), this->thresholds));
+}
+
+unsigned int LODChain::select(const unsigned int rank) const
+{
+    switch (levels.size())
+    {
+        case 1: return 0;
+        case 2: return selectLevel<2>(thresholds.data(), rank);
+        case 3: return selectLevel<3>(thresholds.data(), rank);
+        case 4: return selectLevel<4>(thresholds.data(), rank);
+    }
+
+    unsigned int level = 0;
+
+    while (level < thresholds.size() && rank >= thresholds[level])
+    {
+        level++;
+    }
+
+    return level;
+}
+
+const Model& LODChain::getLevel(const unsigned int level) const
+{
+    return levels[level];
+}
+
+Model& LODChain::getLevel(const unsigned int level)
+{
+    return levels[level];
+}
+
+unsigned int LODChain::getLevelCount() const
+{
+    return static_cast<unsigned int>(levels.size());
+}
+
+void LODChain::setThresholds(const std::vector<unsigned int>& thresholds)
+{
+    assert(areThresholdsValid(levels.size(), thresholds));
+    this->thresholds = thresholds;
+}
+
+void LODChain::addLevel(Model&& level, const unsigned int threshold)
+{
+    levels.push_back(std::move(level));
+
+    if (levels.size() > 1)
+    {
+        thresholds.push_back(std::max(threshold, thresholds.empty() ? 1u : thresholds.back()));
+    }
+}
+
+void LODChain::setThresholdsFromErrors(const float errorPerRank)
+{
+    thresholds.clear();
+
+    for (unsigned int i = 1; i < levels.size(); ++i)
     {
-        meshes[i].cleanUp();
+        const unsigned int rank = static_cast<unsigned int>(std::ceil(levels[i].getGeometricError() / errorPerRank));
+        thresholds.push_back(std::max(rank, thresholds.empty() ? 1u : thresholds.back()));
     }
 }
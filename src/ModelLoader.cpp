@@ -0,0 +1,628 @@
+#include <glad/glad.h>
+#include <stb_image.h>
+#include <assimp/Importer.hpp>
+#include <assimp/DefaultIOSystem.h>
+#include <assimp/scene.h>
+#include <assimp/postprocess.h>
+
+#include <atomic>
+#include <limits>
+#include <sstream>
+#include <iostream>
+#include <algorithm>
+
+#include "ModelLoader.h"
+#include "MeshCache.h"
+#include "Simplifier.h"
+#include "GLState.h"
+
+const unsigned int importFlags = aiProcess_Triangulate | aiProcess_FlipUVs;
+
+// Decoded pixels of one texture file, waiting to be uploaded
+struct StagedTexture
+{
+	std::string file;
+	unsigned char* pixels = nullptr;
+	int width = 0;
+	int height = 0;
+	std::string error;
+};
+
+// One level of one mesh, prepared as far as it can be without a GL context
+struct StagedMesh
+{
+	std::vector<Vertex> vertices;
+	std::vector<unsigned int> indices;
+	std::vector<Cluster> clusters;
+	float error = 0.0f;
+};
+
+struct ModelLoader::Load
+{
+	unsigned int index; // Where the load was queued, so workers never read loads while more are being queued
+	std::string rootPath;
+	std::string fileName;
+	unsigned int shader;
+	std::vector<float> ratios; // Empty for a model loaded as it is
+	std::vector<std::vector<Texture>> meshTextures; // Already resident textures for each mesh, if given, so none are decoded
+	float errorPerRank = 0.0f;
+	ImportOptions options;
+
+	std::vector<ImportedMesh> meshes;
+	std::vector<StagedTexture> textures; // One per file any mesh uses
+	std::vector<std::vector<StagedMesh>> levels; // Every mesh of each level, in the order of meshes
+	std::string importLog;
+	std::vector<std::string> meshLogs; // Printed in order on upload, so output reads the same however tasks were scheduled
+	std::atomic<unsigned int> remaining{ 0 }; // Tasks still running
+};
+
+static ImportedMesh processMesh(const aiMesh* const mesh, const aiScene* const scene)
+{
+	unsigned int numVertices = mesh->mNumVertices;
+	std::vector<Vertex> vertices;
+	std::vector<Texture> textures;
+	std::vector<unsigned int> indices;
+	vertices.reserve(numVertices);
+	indices.reserve(mesh->mNumFaces * 3);
+
+	// Process vertex positions and normals
+	for (unsigned int i = 0; i < numVertices; ++i)
+	{
+		const aiVector3D vertex = mesh->mVertices[i];
+		Vertex newVertex;
+		newVertex.position = glm::vec3(vertex.x, vertex.y, vertex.z);
+		const aiVector3D normal = mesh->mNormals[i];
+		newVertex.normal = glm::vec3(normal.x, normal.y, normal.z);
+		vertices.push_back(newVertex);
+	}
+
+	// Process faces and their indices
+	for (unsigned int i = 0; i < mesh->mNumFaces; ++i)
+	{
+		const aiFace face = mesh->mFaces[i];
+
+		for (unsigned int j = 0; j < face.mNumIndices; ++j)
+		{
+			indices.push_back(face.mIndices[j]);
+		}
+	}
+
+	// Process texture coordinates
+	if (mesh->mTextureCoords[0] != nullptr)
+	{
+		for (unsigned int i = 0; i < numVertices; ++i)
+		{
+			const aiVector3D texCoords = mesh->mTextureCoords[0][i];
+			vertices[i].texCoords = glm::vec2(texCoords.x, texCoords.y);
+		}
+	}
+
+	// Process materials and their textures, which are only named here and loaded once every mesh is known
+	unsigned int numSpecular = 1;
+	unsigned int numDiffuse = 1;
+
+	if (mesh->mMaterialIndex >= 0)
+	{
+		const aiMaterial* const material = scene->mMaterials[mesh->mMaterialIndex];
+
+		for (unsigned int isSpecular = 0; isSpecular < 2; ++isSpecular)
+		{
+			bool specular = (bool)isSpecular;
+			const aiTextureType type = specular ? aiTextureType_SPECULAR : aiTextureType_DIFFUSE;
+
+			for (unsigned int i = 0; i < material->GetTextureCount(type); ++i)
+			{
+				aiString path;
+				material->GetTexture(type, i, &path);
+				std::string uniform = "texture_";
+
+				if (specular)
+				{
+					uniform += "specular" + std::to_string(numSpecular);
+					numSpecular++;
+				}
+				else
+				{
+					uniform += "diffuse" + std::to_string(numDiffuse);
+					numDiffuse++;
+				}
+
+				textures.push_back(Texture(0, specular, path.C_Str(), uniform));
+			}
+		}
+	}
+
+	return ImportedMesh{ mesh->mName.C_Str(), std::move(vertices), std::move(indices), std::move(textures) };
+}
+
+// Appends the meshes of node and all of its children to result
+static void processNode(const aiNode* const node, const aiScene* const scene, std::vector<ImportedMesh>& result)
+{
+	// Process meshes in this node
+	for (unsigned int i = 0; i < node->mNumMeshes; ++i)
+	{
+		const aiMesh* const mesh = scene->mMeshes[node->mMeshes[i]];
+		result.push_back(processMesh(mesh, scene));
+	}
+
+	// Recursively process children
+	for (unsigned int i = 0; i < node->mNumChildren; ++i)
+	{
+		processNode(node->mChildren[i], scene, result);
+	}
+}
+
+// Opens files as usual, but notes every one Assimp looks for, so a cache can be checked against files like material libraries too
+class RecordingIOSystem : public Assimp::DefaultIOSystem
+{
+	public:
+		using Assimp::DefaultIOSystem::Exists;
+
+		bool Exists(const char* file) const override
+		{
+			files.push_back(file);
+			return Assimp::DefaultIOSystem::Exists(file);
+		}
+
+		Assimp::IOStream* Open(const char* file, const char* mode = "rb") override
+		{
+			files.push_back(file);
+			return Assimp::DefaultIOSystem::Open(file, mode);
+		}
+
+		mutable std::vector<std::string> files; // In the order they were looked for, possibly more than once
+};
+
+// Hashes every import setting that changes what importModel returns, so a cache built with different ones is rebuilt
+static uint64_t hashImportSettings(const ImportOptions& options)
+{
+	const uint32_t weld = options.weld ? 1 : 0;
+	uint64_t hash = hashBytes(&importFlags, sizeof(importFlags));
+	hash = hashBytes(&weld, sizeof(weld), hash);
+
+	if (options.weld)
+	{
+		hash = hashBytes(&options.weldTolerances, sizeof(WeldTolerances), hash);
+	}
+
+	return hash;
+}
+
+// Reads every mesh in a file, welding them if requested; empty if it couldn't be loaded. Meshes are kept in a cache next to the file,
+// which is read instead of the file itself until the settings, the file or any other file it was imported from change
+static std::vector<ImportedMesh> importModel(const std::string& path, const ImportOptions& options, std::ostream& log)
+{
+	const std::string cachePath = path + ".meshcache";
+	std::vector<ImportedMesh> meshes;
+	MeshCacheKey key;
+	const bool cacheable = findMeshCacheKey(path, hashImportSettings(options), key);
+
+	if (cacheable && readMeshCache(cachePath, key, meshes))
+	{
+		log << "Read " << meshes.size() << " meshes of " << path << " from its cache" << std::endl;
+		return meshes;
+	}
+
+	Assimp::Importer importer;
+	RecordingIOSystem* const files = new RecordingIOSystem(); // Owned by the importer
+	importer.SetIOHandler(files);
+	const aiScene* const scene = importer.ReadFile(path, importFlags);
+
+	if (scene == nullptr || scene->mFlags != NULL && AI_SCENE_FLAGS_INCOMPLETE || scene->mRootNode == nullptr)
+	{
+		log << "Error loading model: " << importer.GetErrorString() << std::endl;
+		return meshes;
+	}
+
+	meshes.reserve(scene->mNumMeshes);
+	processNode(scene->mRootNode, scene, meshes);
+
+	for (unsigned int i = 0; options.weld && i < meshes.size(); ++i)
+	{
+		const size_t vertexCount = meshes[i].vertices.size();
+		weldVertices(meshes[i].vertices, meshes[i].indices, options.weldTolerances);
+		log << "Welded mesh " << meshes[i].name << ": " << vertexCount << " -> " << meshes[i].vertices.size() << " vertices" << std::endl;
+	}
+
+	for (unsigned int i = 0; cacheable && i < files->files.size(); ++i)
+	{
+		if (files->files[i] != path)
+		{
+			addMeshCacheDependency(files->files[i], key);
+		}
+	}
+
+	if (cacheable && !writeMeshCache(cachePath, key, meshes))
+	{
+		log << "Failed to write mesh cache: " << cachePath << std::endl;
+	}
+
+	return meshes;
+}
+
+// Optimizes an imported mesh as requested, leaving it ready to upload
+static StagedMesh stageMesh(const std::string& name, std::vector<Vertex>&& vertices, std::vector<unsigned int>&& indices, const ImportOptions& options, std::ostream& log)
+{
+	StagedMesh staged;
+
+	// Clusters decide the triangle order themselves, so only vertex fetch is optimized
+	if (options.buildClusters)
+	{
+		ClusterHierarchy hierarchy = buildClusterHierarchy(vertices, indices, options.clusterOptions);
+		log << "Clustered mesh " << name << ": " << indices.size() / 3 << " triangles into " << hierarchy.clusters.size() << " clusters over "
+			<< hierarchy.levelCount << " levels" << std::endl;
+
+		if (options.optimize)
+		{
+			optimizeVertexFetch(vertices, hierarchy.indices);
+		}
+
+		staged.vertices = std::move(vertices);
+		staged.indices = std::move(hierarchy.indices);
+		staged.clusters = std::move(hierarchy.clusters);
+
+		return staged;
+	}
+
+	if (options.optimize)
+	{
+		const OptimizationStats stats = optimizeMesh(vertices, indices);
+		log << "Optimized mesh " << name << ": ACMR " << stats.acmrBefore << " -> " << stats.acmrAfter << std::endl;
+	}
+
+	staged.vertices = std::move(vertices);
+	staged.indices = std::move(indices);
+
+	return staged;
+}
+
+ModelLoader::ModelLoader(WorkerPool& workers)
+	: workers(workers)
+{
+}
+
+ModelLoader::~ModelLoader()
+{
+	// Workers still write into loads until they complete
+	{
+		std::unique_lock<std::mutex> lock(mutex);
+		completed.wait(lock, [this] { return ready.size() == pending; });
+	}
+
+	for (unsigned int i = 0; i < loads.size(); ++i)
+	{
+		for (unsigned int j = 0; loads[i] != nullptr && j < loads[i]->textures.size(); ++j)
+		{
+			stbi_image_free(loads[i]->textures[j].pixels);
+		}
+
+		delete loads[i];
+	}
+}
+
+unsigned int ModelLoader::queueModel(const std::string& rootPath, const std::string& fileName, const unsigned int shader, const ImportOptions& options)
+{
+	Load* load = new Load;
+	load->rootPath = rootPath;
+	load->fileName = fileName;
+	load->shader = shader;
+	load->options = options;
+
+	return queue(load);
+}
+
+unsigned int ModelLoader::queueLODChain(const std::string& rootPath, const std::string& fileName, const unsigned int shader, const std::vector<float>& ratios,
+	const float errorPerRank, const ImportOptions& options)
+{
+	Load* load = new Load;
+	load->rootPath = rootPath;
+	load->fileName = fileName;
+	load->shader = shader;
+	load->ratios = ratios;
+	load->errorPerRank = errorPerRank;
+	load->options = options;
+
+	return queue(load);
+}
+
+unsigned int ModelLoader::queueLevel(const std::string& rootPath, const std::string& fileName, const unsigned int shader, const float ratio,
+	const std::vector<std::vector<Texture>>& meshTextures, const ImportOptions& options)
+{
+	Load* load = new Load;
+	load->rootPath = rootPath;
+	load->fileName = fileName;
+	load->shader = shader;
+	load->ratios.push_back(ratio);
+	load->meshTextures = meshTextures;
+	load->options = options;
+
+	return queue(load);
+}
+
+unsigned int ModelLoader::queue(Load* load)
+{
+	load->index = static_cast<unsigned int>(loads.size());
+	loads.push_back(load);
+	pending++;
+	workers.submit([this, load] { import(load); });
+
+	return load->index;
+}
+
+// Once the file is read, every texture and mesh in it is prepared by its own task
+void ModelLoader::import(Load* load)
+{
+	std::ostringstream log;
+	load->meshes = importModel(load->rootPath + load->fileName, load->options, log);
+	load->importLog = log.str();
+
+	for (unsigned int i = 0; load->meshTextures.empty() && i < load->meshes.size(); ++i)
+	{
+		const std::vector<Texture>& textures = load->meshes[i].textures;
+
+		for (unsigned int j = 0; j < textures.size(); ++j)
+		{
+			unsigned int k = 0;
+
+			while (k < load->textures.size() && load->textures[k].file != textures[j].file)
+			{
+				k++;
+			}
+
+			if (k == load->textures.size())
+			{
+				load->textures.emplace_back();
+				load->textures.back().file = textures[j].file;
+			}
+		}
+	}
+
+	load->levels.assign(load->ratios.empty() ? 1 : load->ratios.size(), std::vector<StagedMesh>(load->meshes.size()));
+	load->meshLogs.resize(load->meshes.size());
+	const unsigned int textureCount = static_cast<unsigned int>(load->textures.size());
+	const unsigned int meshCount = static_cast<unsigned int>(load->meshes.size());
+
+	// Counted before anything is submitted, so no task can find itself the last while others are still to come
+	load->remaining = textureCount + meshCount + 1;
+
+	for (unsigned int i = 0; i < textureCount; ++i)
+	{
+		workers.submit([this, load, i] { decodeTexture(load, i); });
+	}
+
+	for (unsigned int i = 0; i < meshCount; ++i)
+	{
+		workers.submit([this, load, i] { prepareMesh(load, i); });
+	}
+
+	complete(load);
+}
+
+void ModelLoader::decodeTexture(Load* load, const unsigned int texture)
+{
+	StagedTexture& staged = load->textures[texture];
+	const std::string path = load->rootPath + staged.file;
+	int channels;
+	staged.pixels = stbi_load(path.c_str(), &staged.width, &staged.height, &channels, 3);
+
+	if (staged.pixels == nullptr)
+	{
+		staged.error = stbi_failure_reason();
+	}
+
+	complete(load);
+}
+
+void ModelLoader::prepareMesh(Load* load, const unsigned int index)
+{
+	ImportedMesh& mesh = load->meshes[index];
+	const ImportOptions& options = load->options;
+	std::ostringstream log;
+
+	if (load->ratios.empty())
+	{
+		load->levels[0][index] = stageMesh(mesh.name, std::move(mesh.vertices), std::move(mesh.indices), options, log);
+	}
+	else
+	{
+		glm::vec3 minimum(std::numeric_limits<float>::max()), maximum(-std::numeric_limits<float>::max());
+
+		for (unsigned int i = 0; i < mesh.vertices.size(); ++i)
+		{
+			minimum = glm::min(minimum, mesh.vertices[i].position);
+			maximum = glm::max(maximum, mesh.vertices[i].position);
+		}
+
+		const glm::vec3 extent = maximum - minimum;
+		const float size = std::max(extent.x, std::max(extent.y, extent.z));
+		std::vector<SimplifiedLevel> levels = generateLevelsOfDetail(mesh.vertices, mesh.indices, load->ratios, options.simplificationError * size);
+
+		for (unsigned int i = 0; i < levels.size(); ++i)
+		{
+			log << "Simplified mesh " << mesh.name << " to " << levels[i].indices.size() / 3 << " of " << mesh.indices.size() / 3
+				<< " triangles, error " << levels[i].error << std::endl;
+
+			// Each level keeps only the vertices it still references
+			std::vector<Vertex> vertices = mesh.vertices;
+			optimizeVertexFetch(vertices, levels[i].indices);
+			load->levels[i][index] = stageMesh(mesh.name, std::move(vertices), std::move(levels[i].indices), options, log);
+			load->levels[i][index].error = levels[i].error;
+		}
+
+		std::vector<Vertex>().swap(mesh.vertices);
+		std::vector<unsigned int>().swap(mesh.indices);
+	}
+
+	load->meshLogs[index] = log.str();
+	complete(load);
+}
+
+void ModelLoader::complete(Load* load)
+{
+	if (--load->remaining > 0)
+	{
+		return;
+	}
+
+	// Notified under the lock, since the loader may be gone as soon as finish sees the last load
+	std::lock_guard<std::mutex> lock(mutex);
+	ready.push_back(load->index);
+	completed.notify_one();
+}
+
+std::vector<LODChain> ModelLoader::finish(GeometryPool& geometry)
+{
+	std::vector<std::vector<Model>> levels(loads.size());
+
+	while (pending > 0)
+	{
+		unsigned int index;
+
+		{
+			std::unique_lock<std::mutex> lock(mutex);
+			completed.wait(lock, [this] { return !ready.empty(); });
+			index = ready.front();
+			ready.pop_front();
+		}
+
+		levels[index] = upload(*loads[index], geometry);
+		pending--;
+	}
+
+	std::vector<LODChain> chains;
+	chains.reserve(loads.size());
+
+	for (unsigned int i = 0; i < loads.size(); ++i)
+	{
+		chains.emplace_back(std::move(levels[i]));
+
+		if (!loads[i]->ratios.empty())
+		{
+			chains.back().setThresholdsFromErrors(loads[i]->errorPerRank);
+		}
+
+		delete loads[i];
+	}
+
+	loads.clear();
+
+	return chains;
+}
+
+bool ModelLoader::poll(GeometryPool& geometry, unsigned int& load, std::vector<Model>& levels)
+{
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+
+		if (ready.empty())
+		{
+			return false;
+		}
+
+		load = ready.front();
+		ready.pop_front();
+	}
+
+	levels = upload(*loads[load], geometry);
+	delete loads[load];
+	loads[load] = nullptr;
+	pending--;
+
+	if (pending == 0)
+	{
+		loads.clear();
+	}
+
+	return true;
+}
+
+unsigned int ModelLoader::getPendingCount() const
+{
+	return pending;
+}
+
+std::vector<Model> ModelLoader::upload(Load& load, GeometryPool& geometry) const
+{
+	std::cout << load.importLog;
+	std::vector<unsigned int> textures;
+	textures.reserve(load.textures.size());
+
+	for (unsigned int i = 0; i < load.textures.size(); ++i)
+	{
+		StagedTexture& staged = load.textures[i];
+		unsigned int texture;
+		glGenTextures(1, &texture);
+
+		// Bind and set texture properties
+		glState.bindTexture(0, GL_TEXTURE_2D, texture);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+
+		if (staged.pixels != nullptr)
+		{
+			glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, staged.width, staged.height, 0, GL_RGB, GL_UNSIGNED_BYTE, staged.pixels);
+			glGenerateMipmap(GL_TEXTURE_2D);
+			stbi_image_free(staged.pixels);
+			staged.pixels = nullptr;
+		}
+		else
+		{
+			std::cout << "Failed to load texture: " << staged.error << std::endl;
+		}
+
+		textures.push_back(texture);
+	}
+
+	std::vector<std::vector<Mesh>> levelMeshes(load.levels.size());
+	std::vector<float> levelErrors(load.levels.size(), 0.0f);
+
+	for (unsigned int i = 0; i < load.meshes.size(); ++i)
+	{
+		std::cout << load.meshLogs[i];
+
+		// Meshes share the texture object of every file they have in common
+		std::vector<Texture> meshTextures = load.meshes[i].textures;
+
+		if (!load.meshTextures.empty())
+		{
+			meshTextures = i < load.meshTextures.size() ? load.meshTextures[i] : std::vector<Texture>{};
+		}
+
+		for (unsigned int j = 0; load.meshTextures.empty() && j < meshTextures.size(); ++j)
+		{
+			for (unsigned int k = 0; k < textures.size(); ++k)
+			{
+				if (load.textures[k].file == meshTextures[j].file)
+				{
+					meshTextures[j].id = textures[k];
+					break;
+				}
+			}
+		}
+
+		for (unsigned int j = 0; j < load.levels.size(); ++j)
+		{
+			StagedMesh& staged = load.levels[j][i];
+			levelErrors[j] = std::max(levelErrors[j], staged.error);
+			levelMeshes[j].emplace_back(geometry, std::move(staged.vertices), std::move(staged.indices), std::vector<Texture>(meshTextures),
+				load.options.vertexFormat, load.options.retainGeometry);
+
+			if (!staged.clusters.empty())
+			{
+				levelMeshes[j].back().setClusters(std::move(staged.clusters));
+			}
+		}
+	}
+
+	std::vector<Model> models;
+	models.reserve(load.levels.size());
+
+	for (unsigned int i = 0; i < load.levels.size(); ++i)
+	{
+		models.emplace_back(std::move(levelMeshes[i]), load.shader, levelErrors[i]);
+	}
+
+	return models;
+}
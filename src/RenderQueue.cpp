@@ -0,0 +1,89 @@
+#include <algorithm>
+#include <utility>
+
+#include "RenderQueue.h"
+
+uint64_t makeSortKey(const unsigned int program, const unsigned int material, const unsigned int vertexArray, const float depth)
+{
+	const uint64_t maxDepth = (1ull << sortKeyDepthBits) - 1;
+	const uint64_t quantizedDepth = static_cast<uint64_t>(std::min(std::max(depth, 0.0f), 1.0f) * maxDepth);
+
+	uint64_t key = program & ((1u << sortKeyProgramBits) - 1);
+	key = key << sortKeyMaterialBits | (material & ((1u << sortKeyMaterialBits) - 1));
+	key = key << sortKeyVertexArrayBits | (vertexArray & ((1u << sortKeyVertexArrayBits) - 1));
+	key = key << sortKeyDepthBits | quantizedDepth;
+
+	return key;
+}
+
+bool RenderQueue::begin(FrameArena& arena, const unsigned int capacity)
+{
+	keys = arena.allocate<uint64_t>(capacity);
+	items = arena.allocate<unsigned int>(capacity);
+	scratchKeys = arena.allocate<uint64_t>(capacity);
+	scratchItems = arena.allocate<unsigned int>(capacity);
+	count = 0;
+	this->capacity = keys != nullptr && items != nullptr && scratchKeys != nullptr && scratchItems != nullptr ? capacity : 0;
+
+	return this->capacity == capacity;
+}
+
+void RenderQueue::push(const uint64_t key, const unsigned int item)
+{
+	if (count < capacity)
+	{
+		keys[count] = key;
+		items[count] = item;
+		count++;
+	}
+}
+
+// Least significant digit first, a byte per pass; passes where every key has the same byte are skipped, which is most of them
+// with few programs and materials
+void RenderQueue::sort()
+{
+	for (unsigned int shift = 0; shift < 64; shift += 8)
+	{
+		unsigned int histogram[257] = {};
+
+		for (unsigned int i = 0; i < count; ++i)
+		{
+			histogram[(keys[i] >> shift & 0xFF) + 1]++;
+		}
+
+		if (count == 0 || histogram[(keys[0] >> shift & 0xFF) + 1] == count)
+		{
+			continue;
+		}
+
+		for (unsigned int i = 0; i < 256; ++i)
+		{
+			histogram[i + 1] += histogram[i];
+		}
+
+		for (unsigned int i = 0; i < count; ++i)
+		{
+			const unsigned int destination = histogram[keys[i] >> shift & 0xFF]++;
+			scratchKeys[destination] = keys[i];
+			scratchItems[destination] = items[i];
+		}
+
+		std::swap(keys, scratchKeys);
+		std::swap(items, scratchItems);
+	}
+}
+
+unsigned int RenderQueue::getCount() const
+{
+	return count;
+}
+
+const uint64_t* RenderQueue::getKeys() const
+{
+	return keys;
+}
+
+const unsigned int* RenderQueue::getItems() const
+{
+	return items;
+}
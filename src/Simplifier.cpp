@@ -0,0 +1,566 @@
+#include <glm/glm.hpp>
+
+#include <cmath>
+#include <cstring>
+#include <cstdint>
+#include <algorithm>
+#include <unordered_map>
+#include <unordered_set>
+
+#include "Simplifier.h"
+
+const double seamWeight = 10.0; // How strongly planes along seams hold their shape, relative to the surface itself
+
+enum class VertexKind : unsigned char
+{
+	Manifold, // Can collapse onto any neighbor
+	Seam, // One of two vertices sharing a position along a UV seam; collapses along the seam only
+	Locked // On an open border, or where more than two vertices share a position
+};
+
+// Symmetric 4x4 matrix summing squared distances to planes, weighted by area
+struct Quadric
+{
+	double a2 = 0, b2 = 0, c2 = 0, d2 = 0;
+	double ab = 0, ac = 0, ad = 0, bc = 0, bd = 0, cd = 0;
+	double weight = 0;
+
+	void addPlane(const glm::vec3& normal, const double d, const double planeWeight)
+	{
+		const double a = normal.x, b = normal.y, c = normal.z;
+		a2 += planeWeight * a * a; b2 += planeWeight * b * b; c2 += planeWeight * c * c; d2 += planeWeight * d * d;
+		ab += planeWeight * a * b; ac += planeWeight * a * c; ad += planeWeight * a * d;
+		bc += planeWeight * b * c; bd += planeWeight * b * d; cd += planeWeight * c * d;
+		weight += planeWeight;
+	}
+
+	void add(const Quadric& other)
+	{
+		a2 += other.a2; b2 += other.b2; c2 += other.c2; d2 += other.d2;
+		ab += other.ab; ac += other.ac; ad += other.ad;
+		bc += other.bc; bd += other.bd; cd += other.cd;
+		weight += other.weight;
+	}
+
+	// Mean squared distance from the point to every plane
+	double evaluate(const glm::vec3& point) const
+	{
+		const double x = point.x, y = point.y, z = point.z;
+		const double result =
+			a2 * x * x + b2 * y * y + c2 * z * z + d2 +
+			2.0 * (ab * x * y + ac * x * z + bc * y * z + ad * x + bd * y + cd * z);
+
+		return weight > 0.0 ? std::fabs(result) / weight : 0.0;
+	}
+};
+
+struct Collapse
+{
+	unsigned int from;
+	unsigned int to;
+	double error;
+};
+
+static uint64_t edgeKey(const unsigned int a, const unsigned int b)
+{
+	return static_cast<uint64_t>(a) << 32 | b;
+}
+
+struct PositionHash
+{
+	size_t operator()(const glm::vec3& position) const
+	{
+		unsigned int bits[3];
+		std::memcpy(bits, &position, sizeof(bits));
+		return (bits[0] * 73856093u) ^ (bits[1] * 19349663u) ^ (bits[2] * 83492791u);
+	}
+};
+
+// Shared state for one simplification; vertices with the same position are grouped under the first of them
+class Simplifier
+{
+	public:
+		Simplifier(const std::vector<Vertex>& vertices, const std::vector<unsigned int>& indices)
+			: indices(indices), vertices(vertices)
+		{
+			const unsigned int vertexCount = static_cast<unsigned int>(vertices.size());
+			positions.resize(vertexCount);
+			wedges.resize(vertexCount);
+			collapses.resize(vertexCount);
+
+			// Link vertices with the same position into rings
+			std::unordered_map<glm::vec3, unsigned int, PositionHash> firstAtPosition;
+
+			for (unsigned int i = 0; i < vertexCount; ++i)
+			{
+				auto inserted = firstAtPosition.emplace(vertices[i].position, i);
+				const unsigned int first = inserted.first->second;
+				positions[i] = first;
+				wedges[i] = i;
+
+				if (first != i)
+				{
+					wedges[i] = wedges[first];
+					wedges[first] = i;
+				}
+
+				collapses[i] = i;
+			}
+
+			classifyVertices();
+			computeQuadrics();
+		}
+
+		float simplify(const unsigned int targetIndexCount, const float targetError)
+		{
+			const double errorLimit = static_cast<double>(targetError) * targetError;
+			double maxError = 0.0;
+
+			while (indices.size() > targetIndexCount)
+			{
+				const unsigned int collapsed = collapsePass(targetIndexCount, errorLimit, maxError);
+
+				if (collapsed == 0)
+				{
+					break;
+				}
+
+				applyCollapses();
+			}
+
+			return static_cast<float>(std::sqrt(maxError));
+		}
+
+		std::vector<unsigned int> indices;
+
+	private:
+		void classifyVertices()
+		{
+			const unsigned int vertexCount = static_cast<unsigned int>(vertices.size());
+			std::unordered_set<uint64_t> vertexEdges;
+			std::unordered_set<uint64_t> positionEdges;
+
+			for (unsigned int i = 0; i < indices.size(); i += 3)
+			{
+				for (unsigned int j = 0; j < 3; ++j)
+				{
+					const unsigned int a = indices[i + j], b = indices[i + (j + 1) % 3];
+					vertexEdges.insert(edgeKey(a, b));
+					positionEdges.insert(edgeKey(positions[a], positions[b]));
+				}
+			}
+
+			kinds.assign(vertexCount, VertexKind::Manifold);
+			std::vector<unsigned char> seamEdgesOut(vertexCount, 0), seamEdgesIn(vertexCount, 0);
+			std::vector<bool> borders(vertexCount, false);
+
+			for (unsigned int i = 0; i < indices.size(); i += 3)
+			{
+				for (unsigned int j = 0; j < 3; ++j)
+				{
+					const unsigned int a = indices[i + j], b = indices[i + (j + 1) % 3];
+					
+					if (positionEdges.count(edgeKey(positions[b], positions[a])) == 0)
+					{
+						borders[positions[a]] = true;
+						borders[positions[b]] = true;
+					}
+					else if (vertexEdges.count(edgeKey(b, a)) == 0)
+					{
+						seamEdgesOut[a]++;
+						seamEdgesIn[b]++;
+					}
+				}
+			}
+
+			for (unsigned int i = 0; i < vertexCount; ++i)
+			{
+				unsigned int wedgeCount = 1;
+
+				for (unsigned int wedge = wedges[i]; wedge != i; wedge = wedges[wedge])
+				{
+					wedgeCount++;
+				}
+
+				if (borders[positions[i]] || wedgeCount > 2)
+				{
+					kinds[i] = VertexKind::Locked;
+				}
+				else if (wedgeCount == 2)
+				{
+					// A simple seam passes straight through, entering and leaving each side once
+					kinds[i] = seamEdgesOut[i] == 1 && seamEdgesIn[i] == 1 ? VertexKind::Seam : VertexKind::Locked;
+				}
+			}
+
+			seamEdges.clear();
+
+			for (unsigned int i = 0; i < indices.size(); i += 3)
+			{
+				for (unsigned int j = 0; j < 3; ++j)
+				{
+					const unsigned int a = indices[i + j], b = indices[i + (j + 1) % 3];
+
+					if (positionEdges.count(edgeKey(positions[b], positions[a])) != 0 && vertexEdges.count(edgeKey(b, a)) == 0)
+					{
+						seamEdges.insert(edgeKey(a, b));
+					}
+				}
+			}
+
+			this->vertexEdges.swap(vertexEdges);
+		}
+
+		void computeQuadrics()
+		{
+			quadrics.assign(vertices.size(), Quadric{});
+
+			for (unsigned int i = 0; i < indices.size(); i += 3)
+			{
+				const glm::vec3& a = vertices[indices[i]].position;
+				const glm::vec3& b = vertices[indices[i + 1]].position;
+				const glm::vec3& c = vertices[indices[i + 2]].position;
+				glm::vec3 normal = glm::cross(b - a, c - a);
+				const float length = glm::length(normal);
+
+				if (length <= 0.0f)
+				{
+					continue;
+				}
+
+				normal = normal / length;
+				const double area = length * 0.5;
+
+				for (unsigned int j = 0; j < 3; ++j)
+				{
+					quadrics[positions[indices[i + j]]].addPlane(normal, -glm::dot(normal, a), area);
+				}
+
+				// Planes through seam edges, perpendicular to the surface, keep seams from drifting
+				for (unsigned int j = 0; j < 3; ++j)
+				{
+					const unsigned int from = indices[i + j], to = indices[i + (j + 1) % 3];
+
+					if (seamEdges.count(edgeKey(from, to)) == 0)
+					{
+						continue;
+					}
+
+					const glm::vec3 edge = vertices[to].position - vertices[from].position;
+					glm::vec3 edgeNormal = glm::cross(edge, normal);
+					const float edgeLength = glm::length(edgeNormal);
+
+					if (edgeLength > 0.0f)
+					{
+						edgeNormal = edgeNormal / edgeLength;
+						const double d = -glm::dot(edgeNormal, vertices[from].position);
+						const double weight = seamWeight * glm::dot(edge, edge);
+						quadrics[positions[from]].addPlane(edgeNormal, d, weight);
+						quadrics[positions[to]].addPlane(edgeNormal, d, weight);
+					}
+				}
+			}
+		}
+
+		// Finds the wedge of to that neighbors from's other wedge, so both sides of a seam collapse together
+		bool findSeamPartner(const unsigned int from, const unsigned int to, unsigned int& partner) const
+		{
+			const unsigned int otherFrom = wedges[from];
+			unsigned int wedge = to;
+
+			do
+			{
+				if (vertexEdges.count(edgeKey(otherFrom, wedge)) != 0 || vertexEdges.count(edgeKey(wedge, otherFrom)) != 0)
+				{
+					partner = wedge;
+					return true;
+				}
+
+				wedge = wedges[wedge];
+			} while (wedge != to);
+
+			return false;
+		}
+
+		bool canCollapse(const unsigned int from, const unsigned int to) const
+		{
+			switch (kinds[from])
+			{
+				case VertexKind::Manifold:
+					return true;
+				case VertexKind::Seam:
+					return seamEdges.count(edgeKey(from, to)) != 0 || seamEdges.count(edgeKey(to, from)) != 0;
+				default:
+					return false;
+			}
+		}
+
+		// Rejects collapses that would flip a triangle around from or pinch the surface into a non-manifold edge
+		bool isCollapseValid(const unsigned int fromPosition, const unsigned int toPosition) const
+		{
+			const glm::vec3& target = vertices[toPosition].position;
+			unsigned int sharedNeighbors = 0;
+
+			for (unsigned int k = adjacencyOffsets[fromPosition]; k < adjacencyOffsets[fromPosition + 1]; ++k)
+			{
+				const unsigned int triangle = adjacency[k];
+				unsigned int corners[3];
+				bool hasTarget = false;
+
+				for (unsigned int j = 0; j < 3; ++j)
+				{
+					corners[j] = positions[indices[triangle * 3 + j]];
+					hasTarget = hasTarget || corners[j] == toPosition;
+				}
+
+				if (hasTarget)
+				{
+					continue;
+				}
+
+				glm::vec3 before[3], after[3];
+
+				for (unsigned int j = 0; j < 3; ++j)
+				{
+					before[j] = vertices[corners[j]].position;
+					after[j] = corners[j] == fromPosition ? target : before[j];
+				}
+
+				const glm::vec3 normalBefore = glm::cross(before[1] - before[0], before[2] - before[0]);
+				const glm::vec3 normalAfter = glm::cross(after[1] - after[0], after[2] - after[0]);
+
+				if (glm::dot(normalBefore, normalAfter) <= 0.0f)
+				{
+					return false;
+				}
+			}
+
+			// The link condition: the two ends of an interior edge may only share the two vertices opposite it
+			for (unsigned int k = adjacencyOffsets[fromPosition]; k < adjacencyOffsets[fromPosition + 1]; ++k)
+			{
+				for (unsigned int j = 0; j < 3; ++j)
+				{
+					const unsigned int neighbor = positions[indices[adjacency[k] * 3 + j]];
+
+					if (neighbor == fromPosition || neighbor == toPosition || neighborMarks[neighbor] == markStamp)
+					{
+						continue;
+					}
+
+					neighborMarks[neighbor] = markStamp;
+
+					for (unsigned int m = adjacencyOffsets[toPosition]; m < adjacencyOffsets[toPosition + 1]; ++m)
+					{
+						const unsigned int* corners = &indices[adjacency[m] * 3];
+
+						if (positions[corners[0]] == neighbor || positions[corners[1]] == neighbor || positions[corners[2]] == neighbor)
+						{
+							sharedNeighbors++;
+							break;
+						}
+					}
+				}
+			}
+
+			markStamp++;
+			return sharedNeighbors <= 2;
+		}
+
+		void buildAdjacency()
+		{
+			const unsigned int vertexCount = static_cast<unsigned int>(vertices.size());
+			adjacencyOffsets.assign(vertexCount + 1, 0);
+
+			for (unsigned int i = 0; i < indices.size(); ++i)
+			{
+				adjacencyOffsets[positions[indices[i]] + 1]++;
+			}
+
+			for (unsigned int i = 0; i < vertexCount; ++i)
+			{
+				adjacencyOffsets[i + 1] += adjacencyOffsets[i];
+			}
+
+			adjacency.resize(indices.size());
+			std::vector<unsigned int> filled(adjacencyOffsets.begin(), adjacencyOffsets.end() - 1);
+
+			for (unsigned int i = 0; i < indices.size(); ++i)
+			{
+				adjacency[filled[positions[indices[i]]]++] = i / 3;
+			}
+		}
+
+		// Collapses as many of the cheapest edges as possible without two collapses touching the same triangles
+		unsigned int collapsePass(const unsigned int targetIndexCount, const double errorLimit, double& maxError)
+		{
+			buildAdjacency();
+			neighborMarks.assign(vertices.size(), 0);
+			markStamp = 1;
+
+			std::vector<Collapse> candidates;
+
+			for (unsigned int i = 0; i < indices.size(); i += 3)
+			{
+				for (unsigned int j = 0; j < 3; ++j)
+				{
+					const unsigned int a = indices[i + j], b = indices[i + (j + 1) % 3];
+
+					for (unsigned int direction = 0; direction < 2; ++direction)
+					{
+						const unsigned int from = direction == 0 ? a : b;
+						const unsigned int to = direction == 0 ? b : a;
+
+						if (canCollapse(from, to))
+						{
+							Quadric quadric = quadrics[positions[from]];
+							quadric.add(quadrics[positions[to]]);
+							candidates.push_back(Collapse{ from, to, quadric.evaluate(vertices[to].position) });
+						}
+					}
+				}
+			}
+
+			std::sort(candidates.begin(), candidates.end(), [](const Collapse& a, const Collapse& b)
+			{
+				return a.error != b.error ? a.error < b.error : (a.from != b.from ? a.from < b.from : a.to < b.to);
+			});
+
+			std::vector<bool> touched(vertices.size(), false);
+			const unsigned int triangleCount = static_cast<unsigned int>(indices.size() / 3);
+			const unsigned int targetTriangles = targetIndexCount / 3;
+			unsigned int removedTriangles = 0;
+			unsigned int collapsed = 0;
+
+			for (unsigned int i = 0; i < candidates.size() && triangleCount - removedTriangles > targetTriangles; ++i)
+			{
+				const Collapse& collapse = candidates[i];
+
+				if (collapse.error > errorLimit)
+				{
+					break;
+				}
+
+				const unsigned int fromPosition = positions[collapse.from];
+				const unsigned int toPosition = positions[collapse.to];
+				unsigned int partner = 0;
+
+				if (touched[fromPosition] || touched[toPosition] || collapses[collapse.from] != collapse.from)
+				{
+					continue;
+				}
+
+				if (kinds[collapse.from] == VertexKind::Seam && !findSeamPartner(collapse.from, collapse.to, partner))
+				{
+					continue;
+				}
+
+				if (!isCollapseValid(fromPosition, toPosition))
+				{
+					continue;
+				}
+
+				collapses[collapse.from] = collapse.to;
+
+				if (kinds[collapse.from] == VertexKind::Seam)
+				{
+					collapses[wedges[collapse.from]] = partner;
+				}
+
+				quadrics[toPosition].add(quadrics[fromPosition]);
+				maxError = std::max(maxError, collapse.error);
+				collapsed++;
+
+				// Everything around the collapse changes shape, so none of it can be validated again this pass
+				for (unsigned int k = adjacencyOffsets[fromPosition]; k < adjacencyOffsets[fromPosition + 1]; ++k)
+				{
+					const unsigned int triangle = adjacency[k];
+					bool hasTarget = false;
+
+					for (unsigned int j = 0; j < 3; ++j)
+					{
+						const unsigned int corner = positions[indices[triangle * 3 + j]];
+						touched[corner] = true;
+						hasTarget = hasTarget || corner == toPosition;
+					}
+
+					removedTriangles += hasTarget;
+				}
+			}
+
+			return collapsed;
+		}
+
+		// Moves indices onto their collapse targets and drops triangles that have become degenerate
+		void applyCollapses()
+		{
+			unsigned int write = 0;
+
+			for (unsigned int i = 0; i < indices.size(); i += 3)
+			{
+				const unsigned int a = collapses[indices[i]], b = collapses[indices[i + 1]], c = collapses[indices[i + 2]];
+
+				if (positions[a] == positions[b] || positions[b] == positions[c] || positions[a] == positions[c])
+				{
+					continue;
+				}
+
+				indices[write++] = a;
+				indices[write++] = b;
+				indices[write++] = c;
+			}
+
+			indices.resize(write);
+
+			// Collapsed vertices leave their seam rings, and targets keep all of the error from collapses into them
+			for (unsigned int i = 0; i < collapses.size(); ++i)
+			{
+				collapses[i] = i;
+			}
+		}
+
+		const std::vector<Vertex>& vertices;
+		std::vector<unsigned int> positions; // First vertex with the same position as each vertex
+		std::vector<unsigned int> wedges; // Next vertex with the same position, in a ring
+		std::vector<unsigned int> collapses; // Where each vertex moves in the current pass; itself if it doesn't
+		std::vector<VertexKind> kinds;
+		std::vector<Quadric> quadrics; // Indexed by position
+		std::unordered_set<uint64_t> vertexEdges;
+		std::unordered_set<uint64_t> seamEdges; // Directed edges with no twin in vertex space, but one by position
+
+		std::vector<unsigned int> adjacencyOffsets; // Triangles around each position
+		std::vector<unsigned int> adjacency;
+		mutable std::vector<unsigned int> neighborMarks;
+		mutable unsigned int markStamp = 1;
+};
+
+SimplifiedLevel simplifyMesh(const std::vector<Vertex>& vertices, const std::vector<unsigned int>& indices, const unsigned int targetIndexCount, const float targetError)
+{
+	Simplifier simplifier(vertices, indices);
+	SimplifiedLevel result;
+	result.error = simplifier.simplify(targetIndexCount, targetError);
+	result.indices.swap(simplifier.indices);
+
+	return result;
+}
+
+std::vector<SimplifiedLevel> generateLevelsOfDetail(const std::vector<Vertex>& vertices, const std::vector<unsigned int>& indices, const std::vector<float>& ratios, const float maxError)
+{
+	std::vector<SimplifiedLevel> result;
+	result.reserve(ratios.size());
+
+	for (unsigned int i = 0; i < ratios.size(); ++i)
+	{
+		const unsigned int targetIndexCount = static_cast<unsigned int>(indices.size() / 3 * ratios[i]) * 3;
+
+		if (ratios[i] >= 1.0f)
+		{
+			result.push_back(SimplifiedLevel{ indices, 0.0f });
+		}
+		else
+		{
+			result.push_back(simplifyMesh(vertices, indices, targetIndexCount, maxError));
+		}
+	}
+
+	return result;
+}
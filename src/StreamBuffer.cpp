@@ -0,0 +1,150 @@
+#include <glad/glad.h>
+#include <GLFW/glfw3.h>
+
+#include "StreamBuffer.h"
+
+// OpenGL 4.4, which the 3.3 headers don't define
+const GLbitfield mapPersistentBit = 0x0040;
+const GLbitfield mapCoherentBit = 0x0080;
+
+typedef void (APIENTRY* BufferStorage)(GLenum target, GLsizeiptr size, const void* data, GLbitfield flags);
+
+static BufferStorage loadBufferStorage()
+{
+	GLint major = 0, minor = 0;
+	glGetIntegerv(GL_MAJOR_VERSION, &major);
+	glGetIntegerv(GL_MINOR_VERSION, &minor);
+
+	return major > 4 || (major == 4 && minor >= 4) ? (BufferStorage)glfwGetProcAddress("glBufferStorage") : nullptr;
+}
+
+StreamBuffer::StreamBuffer(const GLenum target, const size_t regionSize, const size_t alignment)
+	: target(target), alignment(alignment)
+{
+	allocate(regionSize);
+}
+
+StreamBuffer::~StreamBuffer()
+{
+	for (unsigned int i = 0; i < streamFrameCount; ++i)
+	{
+		if (fences[i] != nullptr)
+		{
+			glDeleteSync(fences[i]);
+		}
+	}
+
+	if (persistentData != nullptr)
+	{
+		glBindBuffer(target, buffer);
+		glUnmapBuffer(target);
+	}
+
+	glDeleteBuffers(1, &buffer);
+}
+
+// Replacing the buffer means waiting on every region, since draws in flight may still read any of them
+void StreamBuffer::allocate(const size_t size)
+{
+	static const BufferStorage bufferStorage = loadBufferStorage();
+
+	for (unsigned int i = 0; i < streamFrameCount; ++i)
+	{
+		waitForRegion(i);
+	}
+
+	if (buffer != 0)
+	{
+		glBindBuffer(target, buffer);
+
+		if (persistentData != nullptr)
+		{
+			glUnmapBuffer(target);
+			persistentData = nullptr;
+		}
+
+		glDeleteBuffers(1, &buffer);
+	}
+
+	regionSize = (size + alignment - 1) / alignment * alignment;
+	glGenBuffers(1, &buffer);
+	glBindBuffer(target, buffer);
+
+	if (bufferStorage != nullptr)
+	{
+		const GLbitfield flags = GL_MAP_WRITE_BIT | mapPersistentBit | mapCoherentBit;
+		bufferStorage(target, regionSize * streamFrameCount, nullptr, flags);
+		persistentData = (unsigned char*)glMapBufferRange(target, 0, regionSize * streamFrameCount, flags);
+	}
+	else
+	{
+		glBufferData(target, regionSize * streamFrameCount, nullptr, GL_STREAM_DRAW);
+	}
+}
+
+void StreamBuffer::waitForRegion(const unsigned int region)
+{
+	if (fences[region] == nullptr)
+	{
+		return;
+	}
+
+	GLenum result = glClientWaitSync(fences[region], GL_SYNC_FLUSH_COMMANDS_BIT, 0);
+
+	while (result == GL_TIMEOUT_EXPIRED)
+	{
+		result = glClientWaitSync(fences[region], GL_SYNC_FLUSH_COMMANDS_BIT, 1000000);
+	}
+
+	glDeleteSync(fences[region]);
+	fences[region] = nullptr;
+}
+
+void* StreamBuffer::map(const size_t size)
+{
+	if (size > regionSize)
+	{
+		allocate(size > regionSize * 2 ? size : regionSize * 2);
+	}
+
+	waitForRegion(region);
+
+	if (persistentData != nullptr)
+	{
+		return persistentData + getOffset();
+	}
+
+	// The fence already guarantees the GPU is done with this region, so the driver doesn't need to synchronize the map
+	glBindBuffer(target, buffer);
+	return glMapBufferRange(target, getOffset(), regionSize, GL_MAP_WRITE_BIT | GL_MAP_UNSYNCHRONIZED_BIT | GL_MAP_INVALIDATE_RANGE_BIT);
+}
+
+void StreamBuffer::unmap()
+{
+	if (persistentData == nullptr)
+	{
+		glBindBuffer(target, buffer);
+		glUnmapBuffer(target);
+	}
+}
+
+void StreamBuffer::fence()
+{
+	fences[region] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+	region = (region + 1) % streamFrameCount;
+}
+
+unsigned int StreamBuffer::getBuffer() const
+{
+	return buffer;
+}
+
+size_t StreamBuffer::getOffset() const
+{
+	return region * regionSize;
+}
+
+bool StreamBuffer::isPersistent() const
+{
+	return persistentData != nullptr;
+}
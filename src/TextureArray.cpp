@@ -0,0 +1,153 @@
+#include <glad/glad.h>
+
+#include <iostream>
+
+#include "TextureArray.h"
+#include "GLState.h"
+
+// Where one 2D texture went
+struct PackedTexture
+{
+	unsigned int texture;
+	int width, height;
+	unsigned int array;
+	unsigned int layer;
+};
+
+static void setArrayParameters()
+{
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_REPEAT);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_REPEAT);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+}
+
+unsigned int packTextureArrays(std::vector<LODChain>& chains, const unsigned int shader)
+{
+	std::vector<PackedTexture> packed;
+
+	// Find every distinct texture and its size
+	for (unsigned int i = 0; i < chains.size(); ++i)
+	{
+		for (unsigned int level = 0; level < chains[i].getLevelCount(); ++level)
+		{
+			const std::vector<Mesh>& meshes = chains[i].getLevel(level).getMeshes();
+
+			for (unsigned int j = 0; j < meshes.size(); ++j)
+			{
+				const std::vector<Texture>& textures = meshes[j].getTextures();
+
+				for (unsigned int k = 0; k < textures.size(); ++k)
+				{
+					bool found = textures[k].isArray;
+
+					for (unsigned int m = 0; !found && m < packed.size(); ++m)
+					{
+						found = packed[m].texture == textures[k].id;
+					}
+
+					if (!found)
+					{
+						PackedTexture texture = { textures[k].id, 0, 0, 0, 0 };
+						glState.bindTexture(0, GL_TEXTURE_2D, texture.texture);
+						glGetTexLevelParameteriv(GL_TEXTURE_2D, 0, GL_TEXTURE_WIDTH, &texture.width);
+						glGetTexLevelParameteriv(GL_TEXTURE_2D, 0, GL_TEXTURE_HEIGHT, &texture.height);
+						packed.push_back(texture);
+					}
+				}
+			}
+		}
+	}
+
+	GLint maxLayers = 256;
+	glGetIntegerv(GL_MAX_ARRAY_TEXTURE_LAYERS, &maxLayers);
+	glPixelStorei(GL_PACK_ALIGNMENT, 1);
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+
+	// Textures of the same size share an array, up to the layer limit; OpenGL 3.3 can't copy between textures on the GPU, so each
+	// one is read back and uploaded into its layer
+	std::vector<unsigned char> pixels;
+	unsigned int arrayCount = 0;
+
+	for (unsigned int i = 0; i < packed.size(); ++i)
+	{
+		if (packed[i].array != 0)
+		{
+			continue;
+		}
+
+		std::vector<unsigned int> members;
+
+		for (unsigned int j = i; j < packed.size() && members.size() < static_cast<unsigned int>(maxLayers); ++j)
+		{
+			if (packed[j].array == 0 && packed[j].width == packed[i].width && packed[j].height == packed[i].height)
+			{
+				members.push_back(j);
+			}
+		}
+
+		unsigned int array;
+		glGenTextures(1, &array);
+		glState.bindTexture(0, GL_TEXTURE_2D_ARRAY, array);
+		glTexImage3D(GL_TEXTURE_2D_ARRAY, 0, GL_RGB8, packed[i].width, packed[i].height, static_cast<GLsizei>(members.size()), 0, GL_RGB, GL_UNSIGNED_BYTE, nullptr);
+		setArrayParameters();
+		pixels.resize(static_cast<size_t>(packed[i].width) * packed[i].height * 3);
+
+		for (unsigned int j = 0; j < members.size(); ++j)
+		{
+			PackedTexture& texture = packed[members[j]];
+			glState.bindTexture(0, GL_TEXTURE_2D, texture.texture);
+			glGetTexImage(GL_TEXTURE_2D, 0, GL_RGB, GL_UNSIGNED_BYTE, pixels.data());
+			glState.bindTexture(0, GL_TEXTURE_2D_ARRAY, array);
+			glTexSubImage3D(GL_TEXTURE_2D_ARRAY, 0, 0, 0, j, texture.width, texture.height, 1, GL_RGB, GL_UNSIGNED_BYTE, pixels.data());
+			texture.array = array;
+			texture.layer = j;
+		}
+
+		glGenerateMipmap(GL_TEXTURE_2D_ARRAY);
+		arrayCount++;
+	}
+
+	glPixelStorei(GL_PACK_ALIGNMENT, 4);
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+
+	// Point every mesh at its layers, then free the originals
+	for (unsigned int i = 0; i < chains.size(); ++i)
+	{
+		for (unsigned int level = 0; level < chains[i].getLevelCount(); ++level)
+		{
+			std::vector<Mesh>& meshes = chains[i].getLevel(level).getMeshes();
+
+			for (unsigned int j = 0; j < meshes.size(); ++j)
+			{
+				std::vector<Texture>& textures = meshes[j].getTextures();
+
+				for (unsigned int k = 0; k < textures.size(); ++k)
+				{
+					for (unsigned int m = 0; !textures[k].isArray && m < packed.size(); ++m)
+					{
+						if (packed[m].texture == textures[k].id)
+						{
+							textures[k].id = packed[m].array;
+							textures[k].layer = packed[m].layer;
+							textures[k].isArray = true;
+							textures[k].uniform.replace(0, sizeof("texture_") - 1, "textureArray_");
+						}
+					}
+				}
+
+				meshes[j].setup(shader);
+			}
+		}
+	}
+
+	for (unsigned int i = 0; i < packed.size(); ++i)
+	{
+		glState.forgetTexture(packed[i].texture);
+		glDeleteTextures(1, &packed[i].texture);
+	}
+
+	std::cout << "Packed " << packed.size() << " textures into " << arrayCount << " texture arrays" << std::endl;
+
+	return arrayCount;
+}
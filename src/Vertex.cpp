@@ -0,0 +1,208 @@
+#include <glm/glm.hpp>
+
+#include <cmath>
+#include <cstring>
+#include <algorithm>
+
+#include "Vertex.h"
+
+const float maxPositionError = 0.0005f; // Largest quantization error in model units before falling back to full precision
+const float maxHalfTexCoord = 2048.0f; // Half floats lose sub-texel precision for texture coordinates past this
+
+unsigned int getVertexStride(const VertexFormat format)
+{
+	return format == VertexFormat::Full ? sizeof(Vertex) : sizeof(CompactVertex);
+}
+
+VertexQuantization findQuantization(const std::vector<Vertex>& vertices)
+{
+	VertexQuantization result;
+
+	if (vertices.empty())
+	{
+		return result;
+	}
+
+	glm::vec3 min = vertices[0].position;
+	glm::vec3 max = vertices[0].position;
+
+	for (unsigned int i = 1; i < vertices.size(); ++i)
+	{
+		min = glm::min(min, vertices[i].position);
+		max = glm::max(max, vertices[i].position);
+	}
+
+	result.offset = min;
+	result.scale = max - min;
+	return result;
+}
+
+// Uses preferred unless the mesh is too large for 16-bit positions or its texture coordinates too large for half floats
+VertexFormat chooseVertexFormat(const std::vector<Vertex>& vertices, const VertexQuantization& quantization, const VertexFormat preferred)
+{
+	if (preferred == VertexFormat::Full)
+	{
+		return preferred;
+	}
+
+	const glm::vec3& extents = quantization.scale;
+
+	if (std::max(extents.x, std::max(extents.y, extents.z)) / 65535.0f * 0.5f > maxPositionError)
+	{
+		return VertexFormat::Full;
+	}
+
+	for (unsigned int i = 0; i < vertices.size(); ++i)
+	{
+		const glm::vec2& texCoords = vertices[i].texCoords;
+
+		if (std::fabs(texCoords.x) > maxHalfTexCoord || std::fabs(texCoords.y) > maxHalfTexCoord)
+		{
+			return VertexFormat::Full;
+		}
+	}
+
+	return preferred;
+}
+
+static unsigned short quantizeUnsigned(const float value, const float offset, const float scale)
+{
+	if (scale <= 0.0f)
+	{
+		return 0;
+	}
+
+	const float normalized = std::min(std::max((value - offset) / scale, 0.0f), 1.0f);
+	return static_cast<unsigned short>(std::lround(normalized * 65535.0f));
+}
+
+std::vector<unsigned char> encodeVertices(const std::vector<Vertex>& vertices, const VertexFormat format, const VertexQuantization& quantization)
+{
+	std::vector<unsigned char> result(vertices.size() * getVertexStride(format));
+
+	if (format == VertexFormat::Full)
+	{
+		if (!vertices.empty())
+		{
+			std::memcpy(result.data(), vertices.data(), result.size());
+		}
+
+		return result;
+	}
+
+	CompactVertex* compact = reinterpret_cast<CompactVertex*>(result.data());
+
+	for (unsigned int i = 0; i < vertices.size(); ++i)
+	{
+		const Vertex& vertex = vertices[i];
+		CompactVertex& encoded = compact[i];
+
+		for (unsigned int axis = 0; axis < 3; ++axis)
+		{
+			encoded.position[axis] = quantizeUnsigned(vertex.position[axis], quantization.offset[axis], quantization.scale[axis]);
+		}
+
+		encoded.position[3] = 0;
+		encoded.normal = format == VertexFormat::Octahedral ? encodeOctahedral(vertex.normal) : encodePacked(vertex.normal);
+		encoded.texCoords[0] = encodeHalf(vertex.texCoords.x);
+		encoded.texCoords[1] = encodeHalf(vertex.texCoords.y);
+	}
+
+	return result;
+}
+
+// Rounds to nearest even; values too large for a half become infinity, and ones too small become zero or subnormal
+unsigned short encodeHalf(const float value)
+{
+	unsigned int bits;
+	std::memcpy(&bits, &value, sizeof(bits));
+
+	const unsigned int sign = (bits >> 16) & 0x8000;
+	const int exponent = static_cast<int>((bits >> 23) & 0xff) - 127 + 15;
+	unsigned int mantissa = bits & 0x7fffff;
+
+	if (((bits >> 23) & 0xff) == 0xff)
+	{
+		return static_cast<unsigned short>(sign | 0x7c00 | (mantissa != 0 ? 0x200 : 0)); // Infinity or NaN
+	}
+
+	if (exponent >= 31)
+	{
+		return static_cast<unsigned short>(sign | 0x7c00);
+	}
+
+	if (exponent <= 0)
+	{
+		if (exponent < -10)
+		{
+			return static_cast<unsigned short>(sign);
+		}
+
+		mantissa |= 0x800000;
+		const unsigned int shift = 14 - exponent;
+		unsigned int half = mantissa >> shift;
+		const unsigned int remainder = mantissa & ((1u << shift) - 1);
+		const unsigned int halfway = 1u << (shift - 1);
+
+		if (remainder > halfway || (remainder == halfway && (half & 1)))
+		{
+			half++;
+		}
+
+		return static_cast<unsigned short>(sign | half);
+	}
+
+	unsigned int half = static_cast<unsigned int>(exponent) << 10 | mantissa >> 13;
+	const unsigned int remainder = mantissa & 0x1fff;
+
+	// Carrying out of the mantissa correctly moves on to the next exponent, or to infinity
+	if (remainder > 0x1000 || (remainder == 0x1000 && (half & 1)))
+	{
+		half++;
+	}
+
+	return static_cast<unsigned short>(sign | half);
+}
+
+static glm::vec3 safeNormalize(const glm::vec3& normal)
+{
+	const float length = glm::length(normal);
+	return length > 0.0f ? normal / length : glm::vec3(0.0f, 0.0f, 1.0f);
+}
+
+static float signNotZero(const float value)
+{
+	return value >= 0.0f ? 1.0f : -1.0f;
+}
+
+static unsigned int quantizeSigned(const float value, const float max, const unsigned int mask)
+{
+	const int quantized = static_cast<int>(std::lround(std::min(std::max(value, -1.0f), 1.0f) * max));
+	return static_cast<unsigned int>(quantized) & mask;
+}
+
+// Projects onto an octahedron and unfolds it into a square, stored as two signed normalized 16-bit values
+unsigned int encodeOctahedral(const glm::vec3& normal)
+{
+	const glm::vec3 n = safeNormalize(normal);
+	const float sum = std::fabs(n.x) + std::fabs(n.y) + std::fabs(n.z);
+	float x = n.x / sum;
+	float y = n.y / sum;
+
+	if (n.z < 0.0f)
+	{
+		const float foldedX = (1.0f - std::fabs(y)) * signNotZero(x);
+		const float foldedY = (1.0f - std::fabs(x)) * signNotZero(y);
+		x = foldedX;
+		y = foldedY;
+	}
+
+	return quantizeSigned(x, 32767.0f, 0xffff) | quantizeSigned(y, 32767.0f, 0xffff) << 16;
+}
+
+// Signed normalized 10-bit x, y and z from the lowest bits up, matching GL_INT_2_10_10_10_REV
+unsigned int encodePacked(const glm::vec3& normal)
+{
+	const glm::vec3 n = safeNormalize(normal);
+	return quantizeSigned(n.x, 511.0f, 0x3ff) | quantizeSigned(n.y, 511.0f, 0x3ff) << 10 | quantizeSigned(n.z, 511.0f, 0x3ff) << 20;
+}
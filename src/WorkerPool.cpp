@@ -0,0 +1,72 @@
+#include <algorithm>
+
+#include "WorkerPool.h"
+
+WorkerPool::WorkerPool(unsigned int threadCount)
+{
+	if (threadCount == 0)
+	{
+		// hardware_concurrency may not know, and returns 0
+		threadCount = std::max(std::thread::hardware_concurrency(), 2u) - 1;
+	}
+
+	threads.reserve(threadCount);
+
+	for (unsigned int i = 0; i < threadCount; ++i)
+	{
+		threads.emplace_back(&WorkerPool::run, this);
+	}
+}
+
+WorkerPool::~WorkerPool()
+{
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		stopping = true;
+	}
+
+	available.notify_all();
+
+	for (unsigned int i = 0; i < threads.size(); ++i)
+	{
+		threads[i].join();
+	}
+}
+
+void WorkerPool::submit(std::function<void()> task)
+{
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		tasks.push_back(std::move(task));
+	}
+
+	available.notify_one();
+}
+
+unsigned int WorkerPool::getThreadCount() const
+{
+	return static_cast<unsigned int>(threads.size());
+}
+
+void WorkerPool::run()
+{
+	while (true)
+	{
+		std::function<void()> task;
+
+		{
+			std::unique_lock<std::mutex> lock(mutex);
+			available.wait(lock, [this] { return stopping || !tasks.empty(); });
+
+			if (tasks.empty())
+			{
+				return;
+			}
+
+			task = std::move(tasks.front());
+			tasks.pop_front();
+		}
+
+		task();
+	}
+}
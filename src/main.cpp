@@ -4,26 +4,83 @@
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
 #include <glm/gtc/type_ptr.hpp>
-#include <assimp/Importer.hpp>
-#include <assimp/scene.h>
-#include <assimp/postprocess.h>
 
 #include <iostream>
 #include <fstream>
 #include <string>
 #include <cstring>
+#include <cstdio>
+#include <cstdlib>
+#include <new>
 #include <sstream>
 #include <cmath>
 #include <vector>
 #include <limits>
+#include <utility>
 
 #include "Camera.hpp"
 #include "Model.h"
 #include "AABB.h"
 #include "Octree.h"
+#include "Morton.h"
+#include "FrameArena.h"
+#include "GeometryPool.h"
+#include "InstanceBatcher.h"
+#include "StreamBuffer.h"
+#include "GLState.h"
+#include "TextureArray.h"
+#include "LODFader.h"
+#include "ClusterHierarchy.h"
+#include "ImpostorBuilder.h"
+#include "ModelLoader.h"
+#include "WorkerPool.h"
+#include "LODStreamer.h"
 
 const unsigned int SCR_WIDTH = 800;
 const unsigned int SCR_HEIGHT = 600;
+const size_t frameArenaSize = 1 << 20; // Bytes available to transient per-frame data
+const unsigned int initialPoolVertices = 1 << 18; // The geometry pool grows past these as models are loaded
+const unsigned int initialPoolIndices = 1 << 21; // Counted in 16-bit indices
+const float lodErrorPerRank = 0.005f; // Geometric error, in model units, each detail rank further from the camera can hide
+const float lodFadeDuration = 0.5f; // Seconds models take to cross-fade between levels of detail
+const unsigned int impostorRank = 3 * (maxDepth - 1); // The worst rank the octree gives out, for models in octants diagonal on every axis
+const float clusterPixelError = 1.0f; // Most a clustered mesh's simplified clusters may stray from the full-detail surface on screen
+const size_t lodResidencyBudget = 3 << 19; // Bytes of pool memory streamed levels of detail may keep once they're no longer drawn
+
+#ifdef CLUSTER_TEST
+const size_t clusterTestPositions = 64; // Vertices of each clustered mesh the camera is placed on
+#endif
+
+#ifdef ALLOCATION_TEST
+// Build with ALLOCATION_TEST defined to check that steady-state frames never touch the heap
+const unsigned int warmUpFrames = 60;
+const unsigned int testedFrames = 600;
+// Only ever set on the GL thread, so allocations made by workers loading levels of detail aren't counted, nor race on the count
+static thread_local bool trackAllocations = false;
+static unsigned int trackedAllocations = 0;
+
+void* operator new(size_t size)
+{
+    if (trackAllocations)
+    {
+        trackedAllocations++;
+    }
+
+    void* result = std::malloc(size == 0 ? 1 : size);
+
+    if (result == nullptr)
+    {
+        throw std::bad_alloc();
+    }
+
+    return result;
+}
+
+void operator delete(void* pointer) noexcept
+{
+    std::free(pointer);
+}
+#endif
 
 static GLenum getError(const char* file, int line)
 {
@@ -192,177 +249,6 @@ static unsigned int createShader(const std::string& vertexShader, const std::str
     return program;
 }
 
-static unsigned int loadTexture(const char* rootPath, const char* fileName)
-{
-    std::string path = std::string(rootPath) + std::string(fileName);
-    unsigned int texture;
-    glGenTextures(1, &texture);
-
-	// Bind and set texture properties
-	glBindTexture(GL_TEXTURE_2D, texture);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);	
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-
-	// Load texture image
-	int width, height, channels;
-	unsigned char* data = stbi_load(path.c_str(), &width, &height, &channels, 3);
-
-	if (data)
-	{
-		glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, width, height, 0, GL_RGB, GL_UNSIGNED_BYTE, data);
-		glGenerateMipmap(GL_TEXTURE_2D);
-	}
-	else
-	{
-		std::cout << "Failed to load texture: " << stbi_failure_reason() << std::endl;
-	}
-
-	stbi_image_free(data);
-
-    return texture;
-}
-
-static Mesh processMesh(const char* rootPath, const aiMesh* const mesh, const aiScene* const scene, std::vector<Texture>& loadedTextures)
-{
-    unsigned int numVertices = mesh->mNumVertices;
-    std::vector<Vertex> vertices;
-    std::vector<Texture> textures;
-    std::vector<unsigned int> indices;
-
-    // Process vertex positions and normals
-    for (unsigned int i = 0; i < numVertices; ++i)
-    {
-        const aiVector3D vertex = mesh->mVertices[i];
-        Vertex newVertex;
-        newVertex.position = glm::vec3(vertex.x, vertex.y, vertex.z);
-        const aiVector3D normal = mesh->mNormals[i];
-        newVertex.normal = glm::vec3(normal.x, normal.y, normal.z);
-        vertices.push_back(newVertex);
-    }
-
-    // Process faces and their indices
-    for (unsigned int i = 0; i < mesh->mNumFaces; ++i)
-    {
-        const aiFace face = mesh->mFaces[i];
-
-        for (unsigned int j = 0; j < face.mNumIndices; ++j)
-        {
-            indices.push_back(face.mIndices[j]);
-        }
-    }
-    
-    // Process texture coordinates
-    if (mesh->mTextureCoords[0] != nullptr)
-    {
-        for (unsigned int i = 0; i < numVertices; ++i)
-        {
-            const aiVector3D texCoords = mesh->mTextureCoords[0][i];
-            vertices[i].texCoords = glm::vec2(texCoords.x, texCoords.y);
-        }
-    }
-
-    // Process materials and their textures
-    unsigned int numSpecular = 1;
-    unsigned int numDiffuse = 1;
-
-    if (mesh->mMaterialIndex >= 0)
-    {
-        const aiMaterial* const material = scene->mMaterials[mesh->mMaterialIndex];
-
-        for (unsigned int isSpecular = 0; isSpecular < 2; ++isSpecular)
-        {
-            bool specular = (bool)isSpecular;
-            const aiTextureType type = specular ? aiTextureType_SPECULAR : aiTextureType_DIFFUSE;
-
-            for (unsigned int i = 0; i < material->GetTextureCount(type); ++i)
-            {
-                aiString path;
-				material->GetTexture(type, i, &path);
-                const char* cstr = path.C_Str();
-                bool loaded = false;
-                Texture texture;
-                
-                for (unsigned int j = 0; j < loadedTextures.size(); ++j)
-                {
-                    if (std::strcmp(cstr, loadedTextures[j].file) == 0)
-                    {
-                        loaded = true;
-                        texture = loadedTextures[j];
-                        break;
-                    }
-                }
-
-				std::string uniform = "texture_";
-
-				if (specular)
-				{
-					uniform += "specular" + std::to_string(numSpecular);
-					numSpecular++;
-				}
-				else
-				{
-					uniform += "diffuse" + std::to_string(numDiffuse);
-					numDiffuse++;
-				}
-                    
-                if (!loaded)
-                {
-				    texture = Texture(loadTexture(rootPath, cstr), specular, cstr, uniform.c_str());
-                    loadedTextures.push_back(texture);
-                }
-                else
-                {
-                    texture.uniform = uniform.c_str();
-                }
-
-				textures.push_back(texture);
-            }
-        }
-    }
-
-    return Mesh(vertices, indices, textures);
-}
-
-static std::vector<Mesh> processNode(const char* rootPath, const aiNode* const node, const aiScene* const scene, std::vector<Texture>& loadedTextures)
-{
-    std::vector<Mesh> result; 
-
-    // Process meshes in this node
-    for (unsigned int i = 0; i < node->mNumMeshes; ++i)
-    {
-        const aiMesh* const mesh = scene->mMeshes[node->mMeshes[i]];
-        result.push_back(processMesh(rootPath, mesh, scene, loadedTextures));
-    }
-
-    // Recursively process children
-    for (unsigned int i = 0; i < node->mNumChildren; ++i)
-    {
-        std::vector<Mesh> nextMeshes = processNode(rootPath, node->mChildren[i], scene, loadedTextures);
-        result.insert(result.end(), nextMeshes.begin(), nextMeshes.end());
-    }
-
-    return result;
-}
-
-static Model loadModel(const char* rootPath, const char* fileName, const unsigned int shader)
-{
-	Assimp::Importer importer;
-    std::string path = std::string(rootPath) + std::string(fileName);
-    const aiScene* const scene = importer.ReadFile(path, aiProcess_Triangulate | aiProcess_FlipUVs);
-
-    if (scene == nullptr || scene->mFlags != NULL && AI_SCENE_FLAGS_INCOMPLETE || scene->mRootNode == nullptr)
-    {
-        std::cout << "Error loading model: " << importer.GetErrorString() << std::endl;
-        return Model(std::vector<Mesh>{}, 0);
-    }
-
-    std::vector<Texture> loadedTextures; // Possibly change to set
-    Model result(processNode(rootPath, scene->mRootNode, scene, loadedTextures), shader);
-    return result;
-}
-
 int main()
 {
     glfwInit();
@@ -406,73 +292,303 @@ int main()
     const std::string vertexSource = parseShader("res/shaders/shader.vs");
     const std::string fragmentSource = parseShader("res/shaders/shader.fs");
     unsigned int shader = createShader(vertexSource, fragmentSource);
-    glUseProgram(shader);
+    glState.useProgram(shader);
+
+    // Load models, with every mesh and level of detail sharing the same buffers; files are read and meshes prepared on worker
+    // threads, while this thread uploads each model as soon as it's ready
+    GeometryPool* geometry = new GeometryPool(initialPoolVertices, initialPoolIndices);
+    WorkerPool* workers = new WorkerPool();
+    ModelLoader* loader = new ModelLoader(*workers);
+    const double loadStart = glfwGetTime();
+
+    // Levels of detail are generated from the full-detail backpack rather than authored by hand
+    const std::string generatedRoot = "res/backpack/backpack0/";
+    const std::string generatedFile = "backpack.obj";
+    const std::vector<float> generatedRatios{ 1.0f, 0.5f, 0.2f };
+
+    // Streamed levels are only generated once a model first asks for them, so up front there's just the full-detail level, which the
+    // impostor is rendered from, and the coarsest, which models fall back on while the others load
+    const bool streamLevelsOfDetail = true;
+
+    if (streamLevelsOfDetail)
+    {
+        loader->queueLODChain(generatedRoot, generatedFile, shader, std::vector<float>{ generatedRatios.front(), generatedRatios.back() }, lodErrorPerRank);
+    }
+    else
+    {
+        loader->queueLODChain(generatedRoot, generatedFile, shader, generatedRatios, lodErrorPerRank);
+    }
+
+    // Models can instead pick their detail cluster by cluster, so parts near the camera keep detail that parts far away drop
+    const bool useClusterHierarchy = true;
+
+    if (useClusterHierarchy)
+    {
+        ImportOptions clusteredImport;
+        clusteredImport.buildClusters = true;
+#ifdef CLUSTER_TEST
+        clusteredImport.retainGeometry = true; // The test places the camera on the mesh's vertices
+#endif
+        loader->queueModel("res/backpack/backpack0/", "backpack.obj", shader, clusteredImport);
+    }
+
+    std::vector<LODChain> chains = loader->finish(*geometry);
+    std::cout << "Loaded " << chains.size() << " chains on " << workers->getThreadCount() << " worker threads in " << glfwGetTime() - loadStart << " seconds" << std::endl;
+    delete loader;
 
-    // Load models
-    const unsigned int modelCount = 1;
-    Model models[modelCount][levelsOfDetail] = { { loadModel("res/backpack/backpack0/", "backpack.obj", shader), loadModel("res/backpack/backpack1/", "backpack.obj", shader) } };
-    const glm::vec3 modelPositions[modelCount] = { glm::vec3(1.0f, 1.0f, 0.0f) };
+    // Levels in between start out as placeholders; with their errors unknown until loaded, each takes over one rank after the last
+    if (streamLevelsOfDetail)
+    {
+        std::vector<Model> levels;
+        levels.push_back(std::move(chains[0].getLevel(0)));
+
+        for (unsigned int i = 1; i + 1 < generatedRatios.size(); ++i)
+        {
+            levels.emplace_back(std::vector<Mesh>{}, shader);
+        }
+
+        levels.push_back(std::move(chains[0].getLevel(1)));
+        chains[0] = LODChain(std::move(levels));
+    }
+
+    // Same-sized material textures go into layers of texture arrays, so models with different materials can be drawn together
+    const bool useTextureArrays = true;
+
+    if (useTextureArrays)
+    {
+        packTextureArrays(chains, shader);
+    }
+
+    glState.setUniform(glGetUniformLocation(shader, "textureArrays"), useTextureArrays);
+
+    // Samplers of different types can't share a unit, so whichever set goes unused points past the units materials bind
+    const char* const textureSamplers[] = { "texture_diffuse1", "texture_diffuse2", "texture_diffuse3", "texture_specular1", "texture_specular2" };
+    const char* const arraySamplers[] = { "textureArray_diffuse1", "textureArray_specular1" };
+    const unsigned int unusedSamplerCount = useTextureArrays ? 5 : 2;
+
+    for (unsigned int i = 0; i < unusedSamplerCount; ++i)
+    {
+        const char* const sampler = useTextureArrays ? textureSamplers[i] : arraySamplers[i];
+        glState.setUniform(glGetUniformLocation(shader, sampler), cachedTextureUnits - unusedSamplerCount + i);
+    }
+
+    glState.setUniform(glGetUniformLocation(shader, "impostorAtlas"), impostorTextureUnit);
+
+    // The generated chain ends in an impostor, drawn as one quad per instance, for models the octree puts furthest away
+    const bool useImpostors = true;
+
+    if (useImpostors)
+    {
+        chains[0].addLevel(buildImpostor(chains, 0, *geometry, shader), impostorRank);
+    }
+
+    // Every generated level but the coarsest is evicted once unused and over budget, and loaded again when asked for; registered once
+    // textures are final, since reloaded levels reuse them
+    LODStreamer* streamer = new LODStreamer(*workers, lodResidencyBudget);
+
+    for (unsigned int i = 0; streamLevelsOfDetail && i + 1 < generatedRatios.size(); ++i)
+    {
+        streamer->addLevel(chains, 0, i, generatedRoot, generatedFile, shader, generatedRatios[i]);
+    }
+
+    // Models placed in the scene, any number of which can share one LODChain
+    const unsigned int modelCount = 8;
+    const unsigned int clusteredChain = useClusterHierarchy ? 1 : 0;
+    const unsigned int modelChains[modelCount] = { 0, 0, 0, 0, clusteredChain, clusteredChain, clusteredChain, clusteredChain };
+    const glm::vec3 modelPositions[modelCount] = {
+        glm::vec3(1.0f, 1.0f, 0.0f), glm::vec3(-3.0f, 1.0f, 0.0f), glm::vec3(1.0f, 1.0f, -4.0f), glm::vec3(-3.0f, 1.0f, -4.0f),
+        glm::vec3(4.0f, -2.0f, 3.0f), glm::vec3(-4.0f, -2.0f, 3.0f), glm::vec3(4.0f, 2.0f, -4.0f), glm::vec3(-4.0f, 2.0f, 4.0f)
+    };
     // const AABB modelBoxes[modelCount] = { AABB(modelPositions[0], glm::vec3(0.25f), true) };
+    unsigned int modelRanks[modelCount]{ 0 };
     unsigned int modelLODs[modelCount]{ 0 };
 
+    // Models are drawn in batches sharing a level of detail, with one indirect command per mesh and their matrices in an instance buffer
+    const bool allowIndirectDraws = true;
+    InstanceBatcher* batcher = new InstanceBatcher(chains, *geometry, shader, allowIndirectDraws);
+
+    // Changes in level of detail dither from one level to the next rather than popping
+    const bool fadeLevelsOfDetail = true;
+    LODFader fader(modelCount, fadeLevelsOfDetail ? lodFadeDuration : 0.0f);
+
     // Construct scene octree
     const AABB sceneBox = AABB(glm::vec3(0.0f), glm::vec3(6.0f), true);
-    Node* root = build(sceneBox, std::vector<unsigned int>{}, modelPositions, modelCount, 0);
+    std::vector<unsigned int> leafModels; // Indices for every leaf too large for its inline buffer
+    Node* root = build(sceneBox, std::vector<unsigned int>{}, modelPositions, modelCount, 0, leafModels);
 
-    // Find uniform locations to send matrices to shaders later
-    int modelLocation = glGetUniformLocation(shader, "model");
-    int viewLocation = glGetUniformLocation(shader, "view");
-    int projectionLocation = glGetUniformLocation(shader, "projection");
-    glUniformMatrix4fv(projectionLocation, 1, GL_FALSE, glm::value_ptr(projection));
+    // Morton codes are computed once as models are inserted, so levels of detail can be found without traversing the octree
+    const bool classifyByMortonCode = true;
+    uint64_t modelCodes[modelCount];
 
+    for (unsigned int i = 0; i < modelCount; ++i)
+    {
+        modelCodes[i] = encodeMorton(sceneBox, modelPositions[i]);
+    }
+
+    // Camera matrices are written once per frame into a ring buffer backing the shader's uniform block
+    GLint uniformAlignment = 1;
+    glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &uniformAlignment);
+    glUniformBlockBinding(shader, glGetUniformBlockIndex(shader, "Camera"), cameraBlockBinding);
+    StreamBuffer* cameraStream = new StreamBuffer(GL_UNIFORM_BUFFER, sizeof(CameraBlock), uniformAlignment);
+
+    FrameArena frameArena(frameArenaSize);
     float lastFrame = 0.0f;
+    int exitCode = 0;
+
+#ifdef CLUSTER_TEST
+    // Build with CLUSTER_TEST defined to check that a camera on a clustered mesh's surface, inside the spheres of the clusters around
+    // it, still sees every part of the mesh at some level of the hierarchy; stops at the first failure, and exits once checked rather
+    // than going on to render
+    for (unsigned int i = 0; useClusterHierarchy && exitCode == 0 && i < chains[clusteredChain].getLevel(0).getMeshes().size(); ++i)
+    {
+        const Mesh& mesh = chains[clusteredChain].getLevel(0).getMeshes()[i];
+        const std::vector<Vertex>& vertices = mesh.getVertices();
+        const size_t step = std::max<size_t>(vertices.size() / clusterTestPositions, 1);
+
+        for (size_t j = 0; exitCode == 0 && j < vertices.size(); j += step)
+        {
+            const ClusterView surfaceView = makeClusterView(projection, vertices[j].position, glm::radians(fov), near, static_cast<float>(SCR_HEIGHT), clusterPixelError);
+
+            if (!isCutComplete(mesh.getClusters(), glm::mat4(1.0f), surfaceView))
+            {
+                std::cout << "Cluster test failed: incomplete cut from vertex " << j << " of clustered mesh " << i << std::endl;
+                exitCode = 1;
+            }
+        }
+    }
+
+    if (exitCode == 0)
+    {
+        std::cout << "Cluster test passed: complete cuts from every sampled surface position" << std::endl;
+    }
+
+    glfwSetWindowShouldClose(window, true); // Skips the render loop, straight to tearing everything down
+#endif
+
+#ifdef ALLOCATION_TEST
+    unsigned int frame = 0;
+#endif
 
     while (!glfwWindowShouldClose(window)) 
     {
         float currentFrame = glfwGetTime();
         deltaTime = currentFrame - lastFrame;
         lastFrame = currentFrame;
+        frameArena.reset();
 
-        std::cout << "Current frame duration: " << std::to_string(deltaTime) << '\r' << std::flush;
-        // std::cout << "FPS: " << std::to_string(1.0f / currentFrame) << '\r' << std::flush;
+        // printf rather than std::to_string so no string is built on the heap every frame; state calls are from the last frame
+        const GLStateCounters& stateCounters = glState.getCounters();
+        std::printf("Current frame duration: %f, state calls issued: %u, skipped: %u, streamed levels: %zu KiB\r", deltaTime, stateCounters.issued,
+            stateCounters.skipped, streamer->getResidentBytes() >> 10);
+        glState.resetCounters();
+        std::fflush(stdout);
 
         handleInput(window);
 
         // After camera, use navigate the octree to find the appropiate levels of detail for each model
-        findLevelsOfDetail(root, modelLODs, camera.position);
+        if (classifyByMortonCode)
+        {
+            classifyLevelsOfDetail(modelCodes, modelCount, encodeMorton(sceneBox, camera.position), modelRanks);
+        }
+        else
+        {
+            findLevelsOfDetail(root, leafModels.data(), modelRanks, camera.position);
+        }
+
+        // Levels that finished loading take their place in their chains, and unused ones are evicted to stay within budget
+        const bool residencyChanged = streamer->update(chains, *geometry);
+
+        if (residencyChanged)
+        {
+            batcher->setChains(chains);
+        }
+
+        // Each model maps the rank from the octree onto however many levels of detail it has, drawing the nearest one loaded until
+        // its own is
+        for (unsigned int i = 0; i < modelCount; ++i)
+        {
+            modelLODs[i] = streamer->resolve(chains, modelChains[i], chains[modelChains[i]].select(modelRanks[i]));
+        }
         
         glClearColor(0.1f, 0.2f, 0.3f, 1.0f);
         glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
         // Update and send matrices to shader before draw
-        glm::mat4 view = glm::lookAt(camera.position, camera.position + camera.forward, camera.up);
-		glUniformMatrix4fv(viewLocation, 1, GL_FALSE, glm::value_ptr(view));
+        const glm::mat4 view = glm::lookAt(camera.position, camera.position + camera.forward, camera.up);
+        CameraBlock* cameraBlock = (CameraBlock*)cameraStream->map(sizeof(CameraBlock));
+        cameraBlock->view = view;
+        cameraBlock->projection = projection;
+        cameraBlock->position = glm::vec4(camera.position, 1.0f);
+        cameraStream->unmap();
+        glBindBufferRange(GL_UNIFORM_BUFFER, cameraBlockBinding, cameraStream->getBuffer(), cameraStream->getOffset(), sizeof(CameraBlock));
         
-		// Load and bind vertex attributes and indices from meshes before draw
+        glm::mat4* modelMatrices = frameArena.allocate<glm::mat4>(modelCount);
+
         for (unsigned int i = 0; i < modelCount; ++i)
         {
-			glm::mat4 model = glm::mat4(1.0f); // Identity matrix
-			model = glm::translate(model, modelPositions[i]);
-            glUniformMatrix4fv(modelLocation, 1, GL_FALSE, glm::value_ptr(model));
+			modelMatrices[i] = glm::translate(glm::mat4(1.0f), modelPositions[i]);
+        }
+        
+        // Models changing level of detail are drawn at both levels until their fade finishes
+        FadedDraws draws;
+        fader.update(modelChains, modelLODs, modelMatrices, currentFrame, frameArena, draws);
 
-            models[i][modelLODs[i]].draw();
+        for (unsigned int i = 0; i < draws.count; ++i)
+        {
+            streamer->markUsed(draws.chains[i], draws.levels[i]);
         }
 
+        // Clustered models choose their clusters from what the camera sees this frame
+        batcher->setClusterView(makeClusterView(projection * view, camera.position, glm::radians(fov), near, static_cast<float>(SCR_HEIGHT),
+            clusterPixelError));
+
+        // Draw calls scale with the number of materials in view rather than the number of models, or meshes with indirect draws
+        DrawGroup* groups = nullptr;
+        const unsigned int groupCount = batcher->batch(draws.chains, draws.levels, draws.matrices, draws.fades, draws.count, camera.position, far, frameArena, groups);
+        batcher->draw(groups, groupCount);
+        cameraStream->fence();
+
         glfwSwapBuffers(window);
         glfwPollEvents();
-    }
 
-    for (unsigned int i = 0; i < modelCount; ++i)
-    {
-        for (unsigned int j = 0; j < levelsOfDetail; ++j)
+#ifdef ALLOCATION_TEST
+        frame++;
+
+        // Frames that load or evict levels of detail allocate by design, so only frames with every level settled are checked
+        if (residencyChanged || streamer->getLoadingCount() > 0)
         {
-            models[i][j].cleanUp();
-		}
+            trackedAllocations = 0;
+        }
+
+        if (trackedAllocations > 0)
+        {
+            trackAllocations = false;
+            std::cout << std::endl << "Allocation test failed: " << trackedAllocations << " heap allocations in frame " << frame << std::endl;
+            exitCode = 1;
+            break;
+        }
+        else if (frame == warmUpFrames + testedFrames)
+        {
+            trackAllocations = false;
+            std::cout << std::endl << "Allocation test passed: no heap allocations in " << testedFrames << " frames" << std::endl;
+            break;
+        }
+
+        trackAllocations = frame >= warmUpFrames;
+#endif
     }
 
+    delete streamer; // Waits on loads still running, which need the workers
+    delete workers;
+    chains.clear(); // Meshes give their ranges back to the pool, so they have to go before it, and it before the context
+    delete geometry;
+    delete batcher;
+    delete cameraStream;
+
     destructNode(root, 0);
+    glState.forgetProgram(shader);
 	glDeleteProgram(shader);
     glfwTerminate();
 
-    return 0;
+    return exitCode;
 }